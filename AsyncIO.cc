@@ -0,0 +1,203 @@
+#include "Bruinbase.h"
+#include "AsyncIO.h"
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+int AsyncIO::state = 0;
+int AsyncIO::ringFd = -1;
+unsigned* AsyncIO::sqHead = NULL;
+unsigned* AsyncIO::sqTail = NULL;
+unsigned AsyncIO::sqMask = 0;
+unsigned* AsyncIO::sqArray = NULL;
+struct io_uring_sqe* AsyncIO::sqes = NULL;
+unsigned AsyncIO::sqQueued = 0;
+unsigned* AsyncIO::cqHead = NULL;
+unsigned* AsyncIO::cqTail = NULL;
+unsigned AsyncIO::cqMask = 0;
+struct io_uring_cqe* AsyncIO::cqes = NULL;
+AsyncIO::Request AsyncIO::requests[AsyncIO::QUEUE_DEPTH];
+int AsyncIO::freeRequest = -1;
+pthread_mutex_t AsyncIO::lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_t AsyncIO::reaper;
+
+bool AsyncIO::available()
+{
+  pthread_mutex_lock(&lock);
+  if (state == 0) state = setup();
+  pthread_mutex_unlock(&lock);
+
+  return state > 0;
+}
+
+RC AsyncIO::queueRead(int fd, void* buffer, size_t length, off_t offset,
+                      Callback done, void* arg)
+{
+  RC rc;
+  struct io_uring_sqe* sqe;
+  unsigned tail;
+  int      r;
+
+  pthread_mutex_lock(&lock);
+
+  // all requests are in flight
+  if (state <= 0 || freeRequest < 0) {
+    pthread_mutex_unlock(&lock);
+    return RC_FILE_READ_FAILED;
+  }
+
+  // hand the queued entries to the kernel if the submission queue is full
+  tail = *sqTail;
+  if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) > sqMask) {
+    pthread_mutex_unlock(&lock);
+    if ((rc = submit()) < 0) return rc;
+    pthread_mutex_lock(&lock);
+    tail = *sqTail;
+  }
+
+  r = freeRequest;
+  freeRequest = requests[r].nextFree;
+  requests[r].done = done;
+  requests[r].arg = arg;
+
+  sqe = &sqes[tail & sqMask];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = (unsigned long) buffer;
+  sqe->len = length;
+  sqe->off = offset;
+  sqe->user_data = r;
+  sqArray[tail & sqMask] = tail & sqMask;
+  __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+  sqQueued++;
+
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+RC AsyncIO::submit()
+{
+  int      n, r;
+  unsigned tail;
+  std::vector<Request> failed;
+
+  pthread_mutex_lock(&lock);
+  while (sqQueued > 0) {
+    n = syscall(__NR_io_uring_enter, ringFd, sqQueued, 0, 0, NULL, 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+    if (n <= 0) break;
+    sqQueued -= n;
+  }
+
+  // the entries the kernel did not take are dropped from the submission
+  // queue, which the kernel reads only in io_uring_enter(), and their
+  // reads complete as failed, so that nobody waits for them
+  tail = *sqTail;
+  for (unsigned i = tail - sqQueued; i != tail; i++) {
+    r = (int) sqes[sqArray[i & sqMask]].user_data;
+    failed.push_back(requests[r]);
+    requests[r].nextFree = freeRequest;
+    freeRequest = r;
+  }
+  __atomic_store_n(sqTail, tail - sqQueued, __ATOMIC_RELEASE);
+  sqQueued = 0;
+  pthread_mutex_unlock(&lock);
+
+  for (unsigned i = 0; i < failed.size(); i++) failed[i].done(failed[i].arg, -EIO);
+
+  return failed.empty() ? 0 : RC_FILE_READ_FAILED;
+}
+
+int AsyncIO::setup()
+{
+  struct io_uring_params p;
+  size_t sqSize, cqSize;
+  char  *sq, *cq;
+  void  *ptr;
+
+  memset(&p, 0, sizeof(p));
+  ringFd = syscall(__NR_io_uring_setup, QUEUE_DEPTH, &p);
+  if (ringFd < 0) return -1;
+
+  // map the submission and completion queues shared with the kernel
+  sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (cqSize > sqSize) sqSize = cqSize;
+    cqSize = sqSize;
+  }
+  ptr = mmap(NULL, sqSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+             ringFd, IORING_OFF_SQ_RING);
+  if (ptr == MAP_FAILED) { ::close(ringFd); return -1; }
+  sq = (char*) ptr;
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    cq = sq;
+  } else {
+    ptr = mmap(NULL, cqSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+               ringFd, IORING_OFF_CQ_RING);
+    if (ptr == MAP_FAILED) { ::close(ringFd); return -1; }
+    cq = (char*) ptr;
+  }
+
+  ptr = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ|PROT_WRITE,
+             MAP_SHARED|MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (ptr == MAP_FAILED) { ::close(ringFd); return -1; }
+  sqes = (struct io_uring_sqe*) ptr;
+
+  sqHead = (unsigned*) (sq + p.sq_off.head);
+  sqTail = (unsigned*) (sq + p.sq_off.tail);
+  sqMask = *(unsigned*) (sq + p.sq_off.ring_mask);
+  sqArray = (unsigned*) (sq + p.sq_off.array);
+  cqHead = (unsigned*) (cq + p.cq_off.head);
+  cqTail = (unsigned*) (cq + p.cq_off.tail);
+  cqMask = *(unsigned*) (cq + p.cq_off.ring_mask);
+  cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+
+  for (unsigned i = 0; i < QUEUE_DEPTH; i++) {
+    requests[i].nextFree = (i + 1 < QUEUE_DEPTH) ? (int) i + 1 : -1;
+  }
+  freeRequest = 0;
+
+  // start the thread reaping the completions
+  if (pthread_create(&reaper, NULL, reap, NULL) != 0) { ::close(ringFd); return -1; }
+  pthread_detach(reaper);
+
+  return 1;
+}
+
+void* AsyncIO::reap(void* arg)
+{
+  unsigned head, tail;
+  int      r, result;
+  Request  req;
+
+  for (;;) {
+    // wait for at least one completion
+    syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+    head = *cqHead;
+    tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      r = (int) cqes[head & cqMask].user_data;
+      result = cqes[head & cqMask].res;
+
+      // release the request and run its callback
+      pthread_mutex_lock(&lock);
+      req = requests[r];
+      requests[r].nextFree = freeRequest;
+      freeRequest = r;
+      pthread_mutex_unlock(&lock);
+
+      req.done(req.arg, result);
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+}
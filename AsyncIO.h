@@ -0,0 +1,97 @@
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <cstddef>
+#include <pthread.h>
+#include <sys/types.h>
+#include "Bruinbase.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * Asynchronous file reads through a process-wide io_uring.
+ * Reads are queued with queueRead() and handed to the kernel together
+ * by submit(), so many reads can be in flight at once. A background
+ * thread reaps the completions and calls the callback of each read.
+ * If the kernel does not support io_uring, available() returns false
+ * and the callers fall back to synchronous reads.
+ */
+class AsyncIO {
+ public:
+
+  /**
+   * the function called when a read completes.
+   * @param arg[IN] the argument given to queueRead()
+   * @param result[IN] # bytes read, or -errno if the read failed
+   */
+  typedef void (*Callback)(void* arg, int result);
+
+  /**
+   * @return true if asynchronous reads are supported.
+   *         the io_uring is set up on the first call.
+   */
+  static bool available();
+
+  /**
+   * queue a read of length bytes at offset of the file fd into buffer.
+   * the read does not start before submit() is called.
+   * @param fd[IN] the file to read
+   * @param buffer[OUT] the memory to read into
+   * @param length[IN] # bytes to read
+   * @param offset[IN] the file offset to read from
+   * @param done[IN] the function called when the read completes
+   * @param arg[IN] the argument passed to done
+   * @return error code. 0 if no error. if the read could not be queued,
+   *         done is not called
+   */
+  static RC queueRead(int fd, void* buffer, size_t length, off_t offset,
+                      Callback done, void* arg);
+
+  /**
+   * start all queued reads. the reads that cannot be started are
+   * completed right away by calling their callback with -EIO.
+   * @return error code. 0 if no error
+   */
+  static RC submit();
+
+ private:
+  static const unsigned QUEUE_DEPTH = 256;  // max # reads in flight
+
+  /**
+   * a read in flight
+   */
+  struct Request {
+    Callback done;
+    void*    arg;
+    int      nextFree;      // next unused request (-1 at the end)
+  };
+
+  static int       state;       // 0: not set up, 1: available, -1: unavailable
+  static int       ringFd;      // file descriptor of the io_uring
+
+  // the submission queue
+  static unsigned* sqHead;
+  static unsigned* sqTail;
+  static unsigned  sqMask;
+  static unsigned* sqArray;
+  static struct io_uring_sqe* sqes;
+  static unsigned  sqQueued;    // # queued entries not submitted yet
+
+  // the completion queue
+  static unsigned* cqHead;
+  static unsigned* cqTail;
+  static unsigned  cqMask;
+  static struct io_uring_cqe* cqes;
+
+  static Request   requests[QUEUE_DEPTH];
+  static int       freeRequest; // first unused request (-1 if all in flight)
+
+  static pthread_mutex_t lock;  // protects the submission queue and requests
+  static pthread_t       reaper;
+
+  static int   setup();
+  static void* reap(void* arg);
+};
+
+#endif // ASYNCIO_H
@@ -1,9 +1,12 @@
 
 #include "BTreeIndex.h"
 #include "BTreeNode.h"
+#include <climits>
 
 using namespace std;
 
+// the first PageFile format version with the node layout of BTreeNode
+static const int INDEX_FORMAT_VERSION = 9;
 
 /*
  * BTreeIndex constructor
@@ -11,10 +14,15 @@ using namespace std;
 BTreeIndex::BTreeIndex()
 {
     rootPid = -1;
+    treeHeight = 0;
+    stale = false;
 }
 
 // Our helper functions to find stored variable information
 RC BTreeIndex::readInfo() {
+	vector<char> page(pf.getPageSize());
+	char* buffer = &page[0];
+
 	if (pf.read(0, buffer) < 0)
 		return RC_FILE_READ_FAILED;
 
@@ -24,29 +32,52 @@ RC BTreeIndex::readInfo() {
 	int* getheight = (int*) (buffer + sizeof(PageId));
 	treeHeight = *getheight;
 
+	// older files have zeros behind the height, so they are not stale
+	int* getstale = getheight + 1;
+	stale = (*getstale != 0);
+
 	return 0;
 }
 
 RC BTreeIndex::writeInfo() {
+	vector<char> page(pf.getPageSize(), 0);
+	char* buffer = &page[0];
+
 	PageId* getroot = (PageId*) buffer;
 	*getroot = rootPid;
 
 	int* getheight = (int*) (buffer + sizeof(PageId));
 	*getheight = treeHeight;
 
+	int* getstale = getheight + 1;
+	*getstale = stale ? 1 : 0;
+
 	return pf.write(0, buffer);
 }
 
 /*
- * Open the index file in read or write mode.
+ * Open the index file in read, write, memory-mapped read or direct read mode.
  * Under 'w' mode, the index file should be created if it does not exist.
  * @param indexname[IN] the name of the index file
- * @param mode[IN] 'r' for read, 'w' for write
+ * @param mode[IN] 'r' for read, 'w' for write, 'm' for memory-mapped read,
+ *                 'd' for direct read
+ * @param pageSize[IN] the page size of the index file if it is created
  * @return error code. 0 if no error
  */
-RC BTreeIndex::open(const string& indexname, char mode)
+RC BTreeIndex::open(const string& indexname, char mode, int pageSize)
 {
-	return pf.open(indexname, mode);
+	RC rc;
+
+	if ((rc = pf.open(indexname, mode, pageSize)) < 0)
+		return rc;
+
+	// the nodes of older files keep their keys inside the entries
+	if (pf.getFormatVersion() < INDEX_FORMAT_VERSION) {
+		pf.close();
+		return RC_INVALID_FILE_FORMAT;
+	}
+
+	return 0;
 }
 
 /*
@@ -55,12 +86,16 @@ RC BTreeIndex::open(const string& indexname, char mode)
  */
 RC BTreeIndex::close()
 {
+    // unpin the page of the cached leaf before the file is closed
+    cacheLeaf = BTLeafNode();
     return pf.close();
 }
 
 RC BTreeIndex::recInsert(int key, const RecordId& rid, PageId pid, int& midKey,
                    int& currheight, PageId& leftChild, PageId& rightChild)
 {
+    RC rc;
+
     // Check if the node is a leafNode
     if (treeHeight == currheight) {
         BTLeafNode newleaf;
@@ -69,26 +104,32 @@ RC BTreeIndex::recInsert(int key, const RecordId& rid, PageId pid, int& midKey,
 
 
         // Check if the insert will cause overflow
-        if (newleaf.getKeyCount() < BTLeafNode::max_key_count) 
+        if (newleaf.getKeyCount() < newleaf.getMaxKeyCount()) 
         {
-            if (newleaf.insert(key, rid) < 0)
-                fprintf(stdout, "leaf insert error %d\n", pid);
-            newleaf.write(pid, pf);
+            if ((rc = newleaf.insert(key, rid)) < 0)
+                return rc;
+            if ((rc = newleaf.write(pid, pf)) < 0)
+                return rc;
             midKey = 0;
         } 
         else 
         {
-            BTLeafNode sibling;
+            BTLeafNode sibling(pf.getPageSize());
             PageId prevNext = newleaf.getNextNodePtr();
-            if (newleaf.insertAndSplit(key, rid, sibling, midKey) < 0)
-                fprintf(stdout, "leaf split error %d\n", pid);
+            if ((rc = newleaf.insertAndSplit(key, rid, sibling, midKey)) < 0)
+                return rc;
 
-            PageId sibPid = pf.endPid();
+            // place the new sibling close to the node it splits from
+            PageId sibPid;
+            if ((rc = pf.allocatePage(pid, sibPid)) < 0)
+                return rc;
             sibling.setNextNodePtr(prevNext);
-            sibling.write(sibPid, pf);
+            if ((rc = sibling.write(sibPid, pf)) < 0)
+                return rc;
 
             newleaf.setNextNodePtr(sibPid);
-            newleaf.write(pid, pf);
+            if ((rc = newleaf.write(pid, pf)) < 0)
+                return rc;
 
             leftChild = pid;
             rightChild = sibPid;
@@ -100,7 +141,8 @@ RC BTreeIndex::recInsert(int key, const RecordId& rid, PageId pid, int& midKey,
         // Find the proper pointer to child
 
         BTNonLeafNode newNonleaf;
-        newNonleaf.read(pid, pf);
+        if (newNonleaf.read(pid, pf) < 0)
+            return RC_FILE_READ_FAILED;
 
         PageId newpid = pid;
 
@@ -108,29 +150,35 @@ RC BTreeIndex::recInsert(int key, const RecordId& rid, PageId pid, int& midKey,
 
         currheight++;
 
-        recInsert(key, rid, newpid, midKey, currheight, leftChild, rightChild);
+        if ((rc = recInsert(key, rid, newpid, midKey, currheight, leftChild, rightChild)) < 0)
+            return rc;
         // Check if insert causes overflow in a child node
         if (midKey == 0) {
             return 0;
         }
-        if (newNonleaf.getKeyCount() < BTLeafNode::max_key_count) 
+        if (newNonleaf.getKeyCount() < newNonleaf.getMaxKeyCount()) 
         {
-            if (newNonleaf.insert(midKey, rightChild) < 0)
-                fprintf(stdout, "Nonleaf insert error %d\n", pid);
+            if ((rc = newNonleaf.insert(midKey, rightChild)) < 0)
+                return rc;
 
-            newNonleaf.write(pid, pf);
+            if ((rc = newNonleaf.write(pid, pf)) < 0)
+                return rc;
             midKey = 0;
         } 
         else 
         {
-            BTNonLeafNode sib;
-            PageId sibPid = pf.endPid();
+            BTNonLeafNode sib(pf.getPageSize());
+            PageId sibPid;
+            if ((rc = pf.allocatePage(pid, sibPid)) < 0)
+                return rc;
             
-            if (newNonleaf.insertAndSplit(key, rightChild, sib, midKey) < 0)
-                fprintf(stdout, "nonleaf split error %d\n", midKey);
+            if ((rc = newNonleaf.insertAndSplit(midKey, rightChild, sib, midKey)) < 0)
+                return rc;
 
-            sib.write(sibPid, pf);
-            newNonleaf.write(pid, pf);
+            if ((rc = sib.write(sibPid, pf)) < 0)
+                return rc;
+            if ((rc = newNonleaf.write(pid, pf)) < 0)
+                return rc;
 
             leftChild = pid;
             rightChild = sibPid;
@@ -148,15 +196,24 @@ RC BTreeIndex::recInsert(int key, const RecordId& rid, PageId pid, int& midKey,
  */
 RC BTreeIndex::insert(int key, const RecordId& rid)
 {
-	if (rootPid < 1) {
-        rootPid = 1;
+    RC     rc;
+    PageId oldRootPid = rootPid;
+    int    oldHeight = treeHeight;
 
-        BTLeafNode newRoot;
+	if (rootPid < 1) {
+        BTLeafNode newRoot(pf.getPageSize());
+        PageId newRootPid = 1;  // page 0 keeps root & height
         
-        if (newRoot.insert(key, rid) < 0)
-            fprintf(stderr, "root error %d\n", rootPid);
+        if ((rc = newRoot.insert(key, rid)) < 0)
+            return rc;
+
+        // the root of a tree that a load emptied takes a free page
+        if (pf.endPid() > 1 && (rc = pf.allocatePage(1, newRootPid)) < 0)
+            return rc;
         
-        newRoot.write(1, pf);
+        if ((rc = newRoot.write(newRootPid, pf)) < 0)
+            return rc;
+        rootPid = newRootPid;
         treeHeight = 0;
     } 
 
@@ -165,25 +222,38 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
         PageId leftChild = -1;
         PageId rightChild = -1;
         int midKey = 0;
-        recInsert(key, rid, rootPid, midKey, currheight, leftChild, rightChild);
+        if ((rc = recInsert(key, rid, rootPid, midKey, currheight, leftChild, rightChild)) < 0)
+            return rc;
 
 
 
         // Check if theres a split at root node
         if (midKey != 0) {
-            BTNonLeafNode newNonRoot;
-            rootPid = pf.endPid();
+            BTNonLeafNode newNonRoot(pf.getPageSize());
+            PageId newRootPid;
+            if ((rc = pf.allocatePage(rootPid, newRootPid)) < 0)
+                return rc;
             
-            if (newNonRoot.initializeRoot(leftChild, midKey, rightChild) < 0)
-                fprintf(stderr, "initialize Root error %d\n", midKey);
-            newNonRoot.write(rootPid, pf);
+            if ((rc = newNonRoot.initializeRoot(leftChild, midKey, rightChild)) < 0)
+                return rc;
+            if ((rc = newNonRoot.write(newRootPid, pf)) < 0)
+                return rc;
+            rootPid = newRootPid;
             treeHeight++;
         }
 
         //treeHeight++;
     }
 
-    writeInfo();
+    // the info page only changes when the tree grows. the root stays the
+    // old one in memory if the new one cannot be recorded
+    if (rootPid != oldRootPid || treeHeight != oldHeight) {
+        if ((rc = writeInfo()) < 0) {
+            rootPid = oldRootPid;
+            treeHeight = oldHeight;
+            return rc;
+        }
+    }
     //treeHeight++;
     return 0;
 
@@ -221,7 +291,7 @@ RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
 	while (currHeight < treeHeight)
 	{
 		BTNonLeafNode nonLeaf;
-		if (nonLeaf.read(cursor.pid, pf) < 0)
+		if (nonLeaf.view(cursor.pid, pf) < 0)
         {
 			return RC_FILE_READ_FAILED;
         }
@@ -237,7 +307,7 @@ RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
 
 	//BTLeafNode leafNode;
 
-	if (cacheLeaf.read(cursor.pid, pf) < 0)
+	if (cacheLeaf.view(cursor.pid, pf) < 0)
     {
 		return RC_FILE_READ_FAILED;
     }
@@ -250,10 +320,99 @@ RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
 }
 
 
+/*
+ * Find the leaf entry of the (key, rid) pair. The entries with the key
+ * are followed from the first one found by locate() into the next leaves.
+ * A leaf may end with entries of the key that the next leaf starts with,
+ * and locate() leads behind their separator, so the search starts at the
+ * next smaller key.
+ * @param key[IN] the key of the entry
+ * @param rid[IN] the RecordId of the entry
+ * @param cursor[OUT] the location of the entry
+ * @param leaf[OUT] the leaf node of the entry, read for modification
+ * @return 0 if the entry is found. Otherwise, RC_NO_SUCH_RECORD
+ */
+RC BTreeIndex::findEntry(int key, const RecordId& rid, IndexCursor& cursor, BTLeafNode& leaf)
+{
+	int      entKey;
+	RecordId entRid;
+
+	if (locate((key > INT_MIN) ? key - 1 : key, cursor) < 0)
+		return RC_NO_SUCH_RECORD;
+	if (leaf.read(cursor.pid, pf) < 0)
+		return RC_FILE_READ_FAILED;
+
+	while (true)
+	{
+		// the entries of a key may continue in the next leaf
+		if (cursor.eid >= leaf.getKeyCount())
+		{
+			PageId next = leaf.getNextNodePtr();
+			if (next <= 0)
+				return RC_NO_SUCH_RECORD;
+			if (leaf.read(next, pf) < 0)
+				return RC_FILE_READ_FAILED;
+			cursor.pid = next;
+			cursor.eid = 0;
+			continue;
+		}
+
+		leaf.readEntry(cursor.eid, entKey, entRid);
+		if (entKey > key)
+			return RC_NO_SUCH_RECORD;
+		if (entKey == key && entRid == rid)
+			return 0;
+		cursor.eid++;
+	}
+}
+
+/*
+ * Remove the (key, rid) pair from the index. The leaf is not merged
+ * with its siblings when it becomes sparse or empty.
+ * @param key[IN] the key of the entry to remove
+ * @param rid[IN] the RecordId of the entry to remove
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::remove(int key, const RecordId& rid)
+{
+	RC          rc;
+	IndexCursor cursor;
+	BTLeafNode  leaf;
+
+	if ((rc = findEntry(key, rid, cursor, leaf)) < 0)
+		return rc;
+
+	// the cached leaf may view the page about to change
+	cacheLeaf = BTLeafNode();
+	leaf.remove(cursor.eid);
+	return leaf.write(cursor.pid, pf);
+}
+
+/*
+ * Point the (key, from) entry of the index to the record moved to to.
+ * @param key[IN] the key of the entry
+ * @param from[IN] the old RecordId of the entry
+ * @param to[IN] the new RecordId of the entry
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::updateRid(int key, const RecordId& from, const RecordId& to)
+{
+	RC          rc;
+	IndexCursor cursor;
+	BTLeafNode  leaf;
+
+	if ((rc = findEntry(key, from, cursor, leaf)) < 0)
+		return rc;
+
+	cacheLeaf = BTLeafNode();
+	leaf.setEntryRid(cursor.eid, to);
+	return leaf.write(cursor.pid, pf);
+}
+
 RC BTreeIndex::readLeafEntry(int eid, int& key, RecordId& rid, IndexCursor& cursor)
 {
     BTLeafNode leafNode;
-    if (leafNode.read(cursor.pid, pf) < 0)
+    if (leafNode.view(cursor.pid, pf) < 0)
       return RC_FILE_READ_FAILED;
 
 
@@ -29,18 +29,20 @@ class BTreeIndex {
   BTreeIndex();
 
   // Our functions to read & write the first page in pf, where we stored height & root
-  // to be stored in memory.
+  // to be stored in memory, and whether a load left the index behind its table.
   RC readInfo();
   RC writeInfo();
 
   /**
-   * Open the index file in read or write mode.
+   * Open the index file in read, write, memory-mapped read or direct read mode.
    * Under 'w' mode, the index file should be created if it does not exist.
    * @param indexname[IN] the name of the index file
-   * @param mode[IN] 'r' for read, 'w' for write
+   * @param mode[IN] 'r' for read, 'w' for write, 'm' for memory-mapped read,
+   *                 'd' for direct read
+   * @param pageSize[IN] the page size of the index file if it is created
    * @return error code. 0 if no error
    */
-  RC open(const std::string& indexname, char mode);
+  RC open(const std::string& indexname, char mode, int pageSize = PageFile::DEFAULT_PAGE_SIZE);
 
   /**
    * Close the index file.
@@ -58,6 +60,25 @@ class BTreeIndex {
   RC recInsert(int key, const RecordId& rid, PageId pid, int& midKey,
                    int& currheight, PageId& leftChild, PageId& rightChild);
 
+  /**
+   * Remove (key, RecordId) pair from the index.
+   * Leaves are not merged when they become sparse.
+   * @param key[IN] the key of the entry to remove
+   * @param rid[IN] the RecordId of the entry to remove
+   * @return error code. RC_NO_SUCH_RECORD if the pair is not in the index
+   */
+  RC remove(int key, const RecordId& rid);
+
+  /**
+   * Change the RecordId of a (key, RecordId) pair, e.g., when the record
+   * is moved within its RecordFile.
+   * @param key[IN] the key of the entry
+   * @param from[IN] the RecordId stored in the entry
+   * @param to[IN] the new RecordId of the entry
+   * @return error code. RC_NO_SUCH_RECORD if the pair is not in the index
+   */
+  RC updateRid(int key, const RecordId& from, const RecordId& to);
+
   /**
    * Run the standard B+Tree key search algorithm and identify the
    * leaf node where searchKey may exist. If an index entry with
@@ -94,6 +115,14 @@ class BTreeIndex {
     return treeHeight;
   }
 
+  /**
+   * @return true if the table may have records without entries in the
+   *         index, since a load was interrupted before it built the index
+   */
+  bool isStale() const {
+    return stale;
+  }
+
   BTLeafNode getCacheLeaf() {
     return cacheLeaf;
   }
@@ -103,22 +132,25 @@ class BTreeIndex {
     return 0;
   }
 
-  PageFile getPf() {
+  const PageFile& getPf() {
     return pf;
   }
   
  private:
+  friend class BTreeLoader;  /// builds the tree of a load bottom-up
+
   PageFile pf;         /// the PageFile used to store the actual b+tree in disk
 
   PageId   rootPid;    /// the PageId of the root node
   int      treeHeight; /// the height of the tree
+  bool     stale;      /// true while a load adds records the index lacks
   /// Note that the content of the above two variables will be gone when
   /// this class is destructed. Make sure to store the values of the two 
   /// variables in disk, so that they can be reconstructed when the index
   /// is opened again later.
   BTLeafNode cacheLeaf;
 
-  char buffer[PageFile::PAGE_SIZE];
+  RC findEntry(int key, const RecordId& rid, IndexCursor& cursor, BTLeafNode& leaf);
 };
 
 #endif /* BTREEINDEX_H */
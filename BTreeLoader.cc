@@ -0,0 +1,392 @@
+#include "BTreeLoader.h"
+#include "WriteAheadLog.h"
+#include <algorithm>
+
+using std::vector;
+
+BTreeLoader::BTreeLoader(BTreeIndex& index, int fillPercent)
+  : index(index), fillPercent(fillPercent), count(0), replace(false), pos(0),
+    hasAdded(false), hasOld(false), oldEid(0)
+{
+  if (fillPercent < 1 || fillPercent > 100) this->fillPercent = DEFAULT_FILL_PERCENT;
+}
+
+BTreeLoader::~BTreeLoader()
+{
+  clear();
+}
+
+RC BTreeLoader::start(const RecordFile& rf)
+{
+  RC          rc;
+  ScanCursor  cursor;
+  int         key;
+  const char* value;
+  int         length;
+  bool        complete;
+
+  // a stale index is built again from the records of the table.
+  // a moved record is indexed by the id of its stub
+  if (index.stale) {
+    replace = true;
+    rf.startScan(cursor);
+    while ((rc = rf.readForward(cursor, key, value, length, complete)) == 0) {
+      if ((rc = add(key, cursor.last)) < 0) return rc;
+    }
+    if (rc != RC_END_OF_FILE) return rc;
+  }
+
+  index.stale = true;
+  return index.writeInfo();
+}
+
+RC BTreeLoader::add(int key, const RecordId& rid)
+{
+  RC    rc;
+  Entry entry;
+
+  entry.key = key;
+  entry.rid = rid;
+  run.push_back(entry);
+  count++;
+
+  // a full run is sorted and written to a temporary file
+  if (run.size() * sizeof(Entry) >= (size_t) RUN_SIZE && (rc = spill()) < 0) return rc;
+
+  return 0;
+}
+
+RC BTreeLoader::finish()
+{
+  RC            rc;
+  vector<Child> level;
+  PageId        oldRoot = index.rootPid;
+  int           oldHeight = index.treeHeight;
+  int           height = 0;
+
+  // without new pairs, the tree stays as it is
+  if (count == 0 && !replace) {
+    index.stale = false;
+    return index.writeInfo();
+  }
+
+  // the added pairs are merged with the entries of the index, unless
+  // they were taken from the whole table
+  if ((rc = startMerge()) < 0) return rc;
+  if (!replace && oldRoot >= 1 && (rc = startOld()) < 0) return rc;
+
+  // the tree is built from its leaves up to a single root
+  if ((rc = buildLeaves(level)) < 0) return rc;
+  while (level.size() > 1) {
+    if ((rc = buildNonLeaves(level)) < 0) return rc;
+    height++;
+  }
+
+  // page 0 refers to the new tree once all of it is written
+  index.rootPid = level.empty() ? -1 : level[0].pid;
+  index.treeHeight = height;
+  index.stale = false;
+  if ((rc = index.writeInfo()) < 0) {
+    index.rootPid = oldRoot;
+    index.treeHeight = oldHeight;
+    index.stale = true;
+    return rc;
+  }
+  clear();
+
+  // the pages of the old tree can be reused by the changes that are
+  // committed with page 0 or after it. the cached leaf is unpinned
+  index.cacheLeaf = BTLeafNode();
+  return (oldRoot >= 1) ? freeTree(oldRoot, oldHeight) : 0;
+}
+
+RC BTreeLoader::spill()
+{
+  FILE* file;
+
+  std::sort(run.begin(), run.end(), lessEntry);
+
+  if ((file = tmpfile()) == NULL) return RC_FILE_OPEN_FAILED;
+  runs.push_back(file);
+  if (fwrite(&run[0], sizeof(Entry), run.size(), file) != run.size()) return RC_FILE_WRITE_FAILED;
+
+  run.clear();
+  return 0;
+}
+
+RC BTreeLoader::startMerge()
+{
+  RC       rc;
+  RunOrder order;
+
+  // a load that fits in memory is read from the sorted run
+  if (runs.empty()) {
+    std::sort(run.begin(), run.end(), lessEntry);
+    pos = 0;
+  } else {
+    if (!run.empty() && (rc = spill()) < 0) return rc;
+    vector<Entry>().swap(run);
+
+    heads.resize(runs.size());
+    heap.clear();
+    for (size_t i = 0; i < runs.size(); i++) {
+      rewind(runs[i]);
+      if (fread(&heads[i], sizeof(Entry), 1, runs[i]) != 1) return RC_FILE_READ_FAILED;
+      heap.push_back(i);
+    }
+    order.heads = &heads;
+    std::make_heap(heap.begin(), heap.end(), order);
+  }
+
+  // the first pair is taken ahead for the merge with the index
+  if ((rc = nextAdded(added)) < 0 && rc != RC_END_OF_FILE) return rc;
+  hasAdded = (rc == 0);
+
+  return 0;
+}
+
+RC BTreeLoader::nextAdded(Entry& entry)
+{
+  RunOrder order;
+  int      r;
+
+  if (runs.empty()) {
+    if (pos >= run.size()) return RC_END_OF_FILE;
+    entry = run[pos++];
+    return 0;
+  }
+
+  if (heap.empty()) return RC_END_OF_FILE;
+
+  // take the smallest head and refill it from its run
+  order.heads = &heads;
+  std::pop_heap(heap.begin(), heap.end(), order);
+  r = heap.back();
+  entry = heads[r];
+  if (fread(&heads[r], sizeof(Entry), 1, runs[r]) == 1) {
+    std::push_heap(heap.begin(), heap.end(), order);
+  } else {
+    heap.pop_back();
+  }
+
+  return 0;
+}
+
+RC BTreeLoader::startOld()
+{
+  RC            rc;
+  PageId        pid = index.rootPid;
+  BTNonLeafNode node;
+
+  // the entries of the index start in the leftmost leaf
+  for (int h = 0; h < index.treeHeight; h++) {
+    if ((rc = node.read(pid, index.pf)) < 0) return rc;
+    if ((rc = node.readChildPtr(0, pid)) < 0) return rc;
+  }
+  if ((rc = oldLeaf.read(pid, index.pf)) < 0) return rc;
+  oldEid = 0;
+
+  return readOld();
+}
+
+RC BTreeLoader::readOld()
+{
+  RC     rc;
+  PageId nextPid;
+
+  // the leaves are followed along their links, passing over the ones
+  // that removals emptied. the last leaf links to page 0
+  while (oldEid >= oldLeaf.getKeyCount()) {
+    if ((nextPid = oldLeaf.getNextNodePtr()) < 1) {
+      hasOld = false;
+      return 0;
+    }
+    if ((rc = oldLeaf.read(nextPid, index.pf)) < 0) return rc;
+    oldEid = 0;
+  }
+
+  if ((rc = oldLeaf.readEntry(oldEid++, old.key, old.rid)) < 0) return rc;
+  hasOld = true;
+
+  return 0;
+}
+
+RC BTreeLoader::next(Entry& entry)
+{
+  RC rc;
+
+  if (!hasAdded && !hasOld) return RC_END_OF_FILE;
+
+  // take the smaller of the next added pair and the next entry
+  if (hasOld && (!hasAdded || lessEntry(old, added))) {
+    entry = old;
+    return readOld();
+  }
+
+  entry = added;
+  if ((rc = nextAdded(added)) == RC_END_OF_FILE) {
+    hasAdded = false;
+    return 0;
+  }
+
+  return rc;
+}
+
+RC BTreeLoader::buildLeaves(vector<Child>& level)
+{
+  RC            rc;
+  Entry         entry;
+  vector<Entry> batch;
+  PageId        pid = -1;
+  size_t        perLeaf = leafFill();
+
+  // a leaf is written once the pairs behind it fill another leaf, so
+  // that the pairs of the last two leaves can be split evenly
+  while ((rc = next(entry)) == 0) {
+    batch.push_back(entry);
+    if (batch.size() >= 2 * perLeaf &&
+        (rc = writeLeaf(batch, leafEnd(batch, perLeaf), false, pid, level)) < 0) return rc;
+  }
+  if (rc != RC_END_OF_FILE) return rc;
+
+  // a tree without pairs has no leaf
+  if (batch.empty()) return 0;
+  if (batch.size() > perLeaf &&
+      (rc = writeLeaf(batch, leafEnd(batch, batch.size() / 2), false, pid, level)) < 0) return rc;
+
+  return writeLeaf(batch, batch.size(), true, pid, level);
+}
+
+size_t BTreeLoader::leafEnd(const vector<Entry>& batch, size_t n) const
+{
+  size_t start = n;
+  size_t end = n;
+  size_t maxKeys = BTLeafNode(index.pf.getPageSize()).getMaxKeyCount();
+
+  // the first key of a leaf separates it from the leaf before it, and a
+  // search for the key starts behind the separator. so the pairs of a
+  // key stay in one leaf: the leaf ends in front of them unless that
+  // leaves it less than half full, or takes all of them if it can
+  while (start > 0 && batch[start - 1].key == batch[n].key) start--;
+  if (start == n || start >= n / 2) return (start > 0) ? start : n;
+  while (end < batch.size() && end < maxKeys && batch[end].key == batch[n - 1].key) end++;
+  if (end < batch.size() && batch[end].key != batch[n - 1].key) return end;
+
+  // a key with more pairs than a leaf holds spans leaves anyway
+  return n;
+}
+
+RC BTreeLoader::writeLeaf(vector<Entry>& batch, size_t n, bool last, PageId& pid, vector<Child>& level)
+{
+  RC         rc;
+  PageId     nextPid = 0;
+  BTLeafNode leaf(index.pf.getPageSize());
+
+  // the leaves take free pages, each one close to the leaf before it
+  if (pid < 0 && (rc = index.pf.allocatePage(index.pf.endPid(), pid)) < 0) return rc;
+  for (size_t i = 0; i < n; i++) {
+    if ((rc = leaf.insert(batch[i].key, batch[i].rid)) < 0) return rc;
+  }
+
+  // the next leaf gets its page now, so that this leaf can link to it
+  if (!last) {
+    if ((rc = index.pf.allocatePage(pid + 1, nextPid)) < 0) return rc;
+    leaf.setNextNodePtr(nextPid);
+  }
+  if ((rc = leaf.write(pid, index.pf)) < 0) return rc;
+
+  Child child = { batch[0].key, pid };
+  level.push_back(child);
+  batch.erase(batch.begin(), batch.begin() + n);
+  pid = nextPid;
+
+  return commitGroup();
+}
+
+RC BTreeLoader::buildNonLeaves(vector<Child>& level)
+{
+  RC            rc;
+  vector<Child> parents;
+  int           pageSize = index.pf.getPageSize();
+  PageId        pid = level.back().pid;
+
+  // a node gets at least three children, so that none is left with one
+  int perNode = std::max(3, BTNonLeafNode(pageSize).getMaxKeyCount() * fillPercent / 100 + 1);
+
+  size_t nodes = (level.size() + perNode - 1) / perNode;
+  size_t first = 0;
+  for (size_t i = 0; i < nodes; i++) {
+    BTNonLeafNode node(pageSize);
+    size_t        n = level.size() / nodes + (i < level.size() % nodes ? 1 : 0);
+
+    // the first key of a child separates it from the child before it
+    if ((rc = node.initializeRoot(level[first].pid, level[first + 1].key, level[first + 1].pid)) < 0) return rc;
+    for (size_t j = first + 2; j < first + n; j++) {
+      if ((rc = node.insert(level[j].key, level[j].pid)) < 0) return rc;
+    }
+
+    if ((rc = index.pf.allocatePage(pid + 1, pid)) < 0) return rc;
+    Child parent = { level[first].key, pid };
+    parents.push_back(parent);
+    first += n;
+
+    if ((rc = node.write(pid, index.pf)) < 0) return rc;
+    if ((rc = commitGroup()) < 0) return rc;
+  }
+
+  level.swap(parents);
+  return 0;
+}
+
+RC BTreeLoader::commitGroup()
+{
+  // no page that is committed refers to the pages of the new tree until
+  // page 0 does, so they are committed in groups while the tree is built
+  if (WriteAheadLog::commitDue()) return WriteAheadLog::commit();
+
+  return 0;
+}
+
+RC BTreeLoader::freeTree(PageId pid, int height)
+{
+  RC            rc;
+  PageId        child;
+  BTNonLeafNode node;
+
+  if (height > 0) {
+    if ((rc = node.read(pid, index.pf)) < 0) return rc;
+    for (int i = 0; i <= node.getKeyCount(); i++) {
+      if ((rc = node.readChildPtr(i, child)) < 0) return rc;
+      if ((rc = freeTree(child, height - 1)) < 0) return rc;
+    }
+  }
+
+  return index.pf.freePage(pid);
+}
+
+int BTreeLoader::leafFill() const
+{
+  // # pairs of a leaf built by finish()
+  return std::max(1, BTLeafNode(index.pf.getPageSize()).getMaxKeyCount() * fillPercent / 100);
+}
+
+void BTreeLoader::clear()
+{
+  for (size_t i = 0; i < runs.size(); i++) fclose(runs[i]);
+  runs.clear();
+  run.clear();
+  heads.clear();
+  heap.clear();
+  pos = 0;
+  count = 0;
+  replace = false;
+  hasAdded = false;
+  hasOld = false;
+}
+
+bool BTreeLoader::lessEntry(const Entry& e1, const Entry& e2)
+{
+  // the pairs of a key keep the order of their records
+  if (e1.key != e2.key) return e1.key < e2.key;
+  return e1.rid < e2.rid;
+}
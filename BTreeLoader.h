@@ -0,0 +1,123 @@
+#ifndef BTREELOADER_H
+#define BTREELOADER_H
+
+#include <cstdio>
+#include <vector>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+#include "BTreeIndex.h"
+#include "BTreeNode.h"
+
+/**
+ * Builds a BTreeIndex bottom-up from the (key, RecordId) pairs of a load.
+ *
+ * The pairs are collected in memory and sorted; a load too large for
+ * RUN_SIZE bytes spills sorted runs to temporary files, which finish()
+ * merges with the entries of the index, read along its leaves. The
+ * merged pairs are packed into leaves filled to a given percent, and each
+ * level of non-leaf nodes is built from the first keys of the level
+ * below, so every page of the new tree is written once.
+ *
+ * The new tree is written to free pages and page 0 refers to it only at
+ * the end, so its pages can be committed while it is built, apart from
+ * the commits of the rows. start() marks the index as stale until then:
+ * if the load is interrupted, the rows committed so far are in the table
+ * but not in the index, and the next load or change of the table builds
+ * the index again from the whole table.
+ */
+class BTreeLoader {
+ public:
+  static const int DEFAULT_FILL_PERCENT = 90;   // how full leaves are packed
+  static const int RUN_SIZE = 32 * 1024 * 1024; // # bytes of a sorted run
+
+  /**
+   * @param index[IN] the open index to load
+   * @param fillPercent[IN] the share of the capacity of a node that is
+   *                        filled, so that later inserts do not split it
+   */
+  BTreeLoader(BTreeIndex& index, int fillPercent = DEFAULT_FILL_PERCENT);
+  ~BTreeLoader();
+
+  /**
+   * mark the index as stale until finish() is done. the mark is committed
+   * with the first rows of the load. if the index is stale already, the
+   * pairs of all records of the table are added, and they replace the
+   * entries of the index.
+   * @param rf[IN] the table of the index
+   * @return error code. 0 if no error
+   */
+  RC start(const RecordFile& rf);
+
+  /**
+   * add a (key, RecordId) pair to the index.
+   * @param key[IN] the key of the record
+   * @param rid[IN] the RecordId of the record
+   * @return error code. 0 if no error
+   */
+  RC add(int key, const RecordId& rid);
+
+  /**
+   * build a new tree from the entries of the index and the pairs added
+   * since start(), point page 0 to it, and free the pages of the old tree.
+   * the caller commits page 0.
+   * @return error code. 0 if no error
+   */
+  RC finish();
+
+ private:
+  struct Entry {
+    int      key;
+    RecordId rid;
+  };
+
+  // a node of the level being built, found by its smallest key
+  struct Child {
+    int    key;
+    PageId pid;
+  };
+
+  BTreeIndex&         index;
+  int                 fillPercent;
+  long long           count;   // # pairs added since start()
+  bool                replace; // true if the pairs replace the entries
+  std::vector<Entry>  run;     // the pairs not spilled yet
+  size_t              pos;     // the next pair of run once it is sorted
+  std::vector<FILE*>  runs;    // the sorted runs spilled to temporary files
+
+  // the merge of the sorted runs
+  std::vector<Entry>  heads;   // the next pair of each run
+  std::vector<int>    heap;    // the runs by their next pair
+
+  // the merge of the added pairs with the entries of the index
+  Entry               added;    // the next added pair
+  bool                hasAdded; // true if added is valid
+  Entry               old;      // the next entry of the index
+  bool                hasOld;   // true if old is valid
+  BTLeafNode          oldLeaf;  // the leaf of old
+  int                 oldEid;   // the entry of oldLeaf behind old
+
+  // orders the heap of runs with the smallest next pair on top
+  struct RunOrder {
+    const std::vector<Entry>* heads;
+    bool operator()(int r1, int r2) const { return lessEntry((*heads)[r2], (*heads)[r1]); }
+  };
+
+  RC spill();
+  RC startMerge();
+  RC nextAdded(Entry& entry);
+  RC startOld();
+  RC readOld();
+  RC next(Entry& entry);
+  RC buildLeaves(std::vector<Child>& level);
+  size_t leafEnd(const std::vector<Entry>& batch, size_t n) const;
+  RC writeLeaf(std::vector<Entry>& batch, size_t n, bool last, PageId& pid, std::vector<Child>& level);
+  RC buildNonLeaves(std::vector<Child>& level);
+  RC commitGroup();
+  RC freeTree(PageId pid, int height);
+  int leafFill() const;
+  void clear();
+
+  static bool lessEntry(const Entry& e1, const Entry& e2);
+};
+
+#endif // BTREELOADER_H
@@ -1,22 +1,101 @@
 #include "BTreeNode.h"
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
+// the keys left to a linear search once a binary search has narrowed
+// them down, i.e., a cache line of keys
+static const int LINEAR_SEARCH_KEYS = 16;
+
+/*
+ * Count the keys of a sorted array that are smaller than key, or not
+ * larger than key if orEqual is set. The range is halved without branches
+ * until a cache line of keys is left, and the keys in it are compared
+ * with SIMD instructions where they are available.
+ */
+static int countKeys(const int* keys, int count, int key, bool orEqual)
+{
+	const int* base = keys;
+	int n = count;
+	int found = 0;
+	int i = 0;
+
+	// the answer stays between base and base + n
+	while (n > LINEAR_SEARCH_KEYS) {
+		int half = n / 2;
+		base = ((base[half] < key) | (orEqual & (base[half] == key))) ? base + half : base;
+		n -= half;
+	}
+
+#if defined(__AVX2__)
+	__m256i wide = _mm256_set1_epi32(key);
+	for (; i + 8 <= n; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (base + i));
+		__m256i lt = _mm256_cmpgt_epi32(wide, v);
+		if (orEqual) lt = _mm256_or_si256(lt, _mm256_cmpeq_epi32(v, wide));
+		found += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(lt)));
+	}
+#endif
+#if defined(__SSE2__)
+	__m128i narrow = _mm_set1_epi32(key);
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (base + i));
+		__m128i lt = _mm_cmplt_epi32(v, narrow);
+		if (orEqual) lt = _mm_or_si128(lt, _mm_cmpeq_epi32(v, narrow));
+		found += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(lt)));
+	}
+#endif
+	for (; i < n; i++)
+		found += (base[i] < key) | (orEqual & (base[i] == key));
+
+	return (base - keys) + found;
+}
+
+/*
+ * Pin the page pid of the PageFile pf in handle. The buffer of a node is
+ * emptied while the node views a page, so that copying the node is cheap.
+ */
+static RC viewPage(PageId pid, const PageFile& pf, PageHandle& handle,
+                   vector<char>& buffer, int& pageSize)
+{
+	RC rc = pf.readPage(pid, handle);
+	pageSize = pf.getPageSize();
+	if (rc < 0) {
+		buffer.assign(pageSize, 0);
+		return rc;
+	}
+	buffer.clear();
+	return 0;
+}
+
 /*
-______________________________________
-|	  |	    |	  |			  |	     |
-|#keys|entry|entry|... ... ...|pageID|
-|_____|_____|_____|___________|______|
-1024 B in a page
-first 4B for int for #keys
-last 4B for PageId of sibling
+___________________________________________________
+|		|		|		|	  |	     |
+|keys[n]|sids[n]|pids[n]| ... |#keys |pageID|
+|_______|_______|_______|_____|______|______|
+page size B in a page (1024 B by default)
+the keys start the page, so that they are aligned to the cache lines,
+and the sids and the 64-bit pids of the record ids follow them
+last 16B for int for #keys (4B padding) and PageId of sibling
 -->
-(1024 - 4 - 4) / entry_size = number of entries in a page
-entry = RecordID & int = 12B
-number of entries = floor 1016/12 = 84
-one for overflow insert --> 83
+(page size - 16) / entry_size = n entries in a page
+entry = key & sid & 64-bit pid = 16B
+number of entries = floor 1008/16 = 63 for 1024 B pages
+one for overflow insert --> 62
 */
 
+/*
+ * Construct an empty node.
+ * @param pageSize[IN] the page size of the index file
+ */
+BTLeafNode::BTLeafNode(int pageSize)
+	: buffer(pageSize, 0), pageSize(pageSize)
+{
+	currPid = -1;
+}
+
 /*
  * Read the content of the node from the page pid in the PageFile pf.
  * @param pid[IN] the PageId to read
@@ -24,9 +103,25 @@ one for overflow insert --> 83
  * @return 0 if successful. Return an error code if there is an error.
  */
 RC BTLeafNode::read(PageId pid, const PageFile& pf)
+{
+	handle.release();
+	currPid = pid;
+	pageSize = pf.getPageSize();
+	buffer.resize(pageSize);
+	return pf.read(pid, &buffer[0]);
+}
+
+/*
+ * Wrap the page pid of the PageFile pf without copying it.
+ * The node cannot be modified until it is read() again.
+ * @param pid[IN] the PageId to view
+ * @param pf[IN] PageFile to view the page of
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::view(PageId pid, const PageFile& pf)
 {
 	currPid = pid;
-	return pf.read(pid, buffer);
+	return viewPage(pid, pf, handle, buffer, pageSize);
 }
     
 /*
@@ -37,7 +132,7 @@ RC BTLeafNode::read(PageId pid, const PageFile& pf)
  */
 RC BTLeafNode::write(PageId pid, PageFile& pf)
 { 
-	return pf.write(pid, buffer);
+	return pf.write(pid, page());
 }
 
 /*
@@ -47,11 +142,20 @@ RC BTLeafNode::write(PageId pid, PageFile& pf)
 int BTLeafNode::getKeyCount()
 { 
 	int key_count = 0;
-	memcpy(&key_count, buffer, sizeof(int));
+	memcpy(&key_count, page() + pageSize - trailer_size, sizeof(int));
 
 	return key_count;
 }
 
+/*
+ * Set the number of keys stored in the node.
+ * @param count[IN] the number of keys
+ */
+void BTLeafNode::setKeyCount(int count)
+{
+	memcpy(&buffer[0] + pageSize - trailer_size, &count, sizeof(int));
+}
+
 /*
  * Insert a (key, rid) pair to the node.
  * @param key[IN] the key to insert
@@ -60,38 +164,31 @@ int BTLeafNode::getKeyCount()
  */
 RC BTLeafNode::insert(int key, const RecordId& rid)
 { 
+	makeWritable();
 	int key_count = getKeyCount();
 
-	if (key_count >= (max_key_count + 1)) // + 1 for one overflow insert
+	int entries = getMaxKeyCount() + 1; // + 1 for one overflow insert
+	if (key_count >= entries)
 		return RC_NODE_FULL;
 
-	leaf_entry* key_start = (leaf_entry *) (buffer + sizeof(int));
-	// keys start after the #keys int in the beginning of buffer
+	int* keys = (int *) &buffer[0];
+	int* sids = keys + entries;
+	PageId* pids = (PageId *) (sids + entries);
 
-	int i;
-	for (i = 0; i < key_count; i++)
-	{
-		if (key_start->ent_key > key)
-			break;
-		key_start++;
-	}
+	// the new entry goes behind the entries with the same key
+	int i = countKeys(keys, key_count, key, true);
 
 	// need to move remaining entries one spot to the right to make space for insert
-	if (i < key_count)
-	{
-		int rest = key_count - i;
-
-		memmove(key_start+1, key_start, entry_size * rest);
-	}
+	int rest = key_count - i;
+	memmove(keys + i + 1, keys + i, sizeof(int) * rest);
+	memmove(sids + i + 1, sids + i, sizeof(int) * rest);
+	memmove(pids + i + 1, pids + i, sizeof(PageId) * rest);
 
-	leaf_entry new_entry;
-	new_entry.rec_id = rid;
-	new_entry.ent_key = key;
+	keys[i] = key;
+	sids[i] = rid.sid;
+	pids[i] = rid.pid;
 
-	*key_start = new_entry;
-
-	key_count++; // after insert succeed, should increment;
-	memcpy(buffer,&key_count, sizeof(int)); // update
+	setKeyCount(key_count + 1); // after insert succeed, should increment
 
 	return 0; 
 }
@@ -115,26 +212,37 @@ RC BTLeafNode::insertAndSplit(int key, const RecordId& rid,
 	int key_count = getKeyCount();
 
 	int front_half = (key_count) / 2;
-	int back_half = key_count / 2;
+	int back_half = key_count - front_half;
 
-	leaf_entry* key_start = (leaf_entry *) (buffer + sizeof(int));
-	leaf_entry* split_point = key_start + front_half;
+	int entries = getMaxKeyCount() + 1;
+	int* keys = (int *) &buffer[0];
+	int* sids = keys + entries;
+	PageId* pids = (PageId *) (sids + entries);
 
-	leaf_entry* sib_key_start = (leaf_entry *) (sibling.buffer + sizeof(int));
+	sibling.makeWritable();
+	int sib_entries = sibling.getMaxKeyCount() + 1;
+	int* sib_keys = (int *) &sibling.buffer[0];
+	int* sib_sids = sib_keys + sib_entries;
+	PageId* sib_pids = (PageId *) (sib_sids + sib_entries);
 
 	// copy backhalf into siblings buffer
-	memcpy(sib_key_start, split_point, sizeof(leaf_entry) * back_half);
-	memcpy(&siblingKey, sib_key_start, sizeof(int)); // copy the first key
+	memcpy(sib_keys, keys + front_half, sizeof(int) * back_half);
+	memcpy(sib_sids, sids + front_half, sizeof(int) * back_half);
+	memcpy(sib_pids, pids + front_half, sizeof(PageId) * back_half);
+	siblingKey = sib_keys[0]; // copy the first key
 	
 	/* UPDATE KEY COUNTS */
-	memcpy(sibling.buffer, &back_half, sizeof(int));
-	memcpy(buffer, &front_half, sizeof(int));
+	sibling.setKeyCount(back_half);
+	setKeyCount(front_half);
 
 	PageId sibNextptr = getNextNodePtr();
 
 	sibling.setNextNodePtr(sibNextptr);
 
-	memset(split_point, '\0', sizeof(leaf_entry) * back_half); // clear out the back half of the buffer
+	// clear out the back half of the buffer
+	memset(keys + front_half, '\0', sizeof(int) * back_half);
+	memset(sids + front_half, '\0', sizeof(int) * back_half);
+	memset(pids + front_half, '\0', sizeof(PageId) * back_half);
 
 	return 0; 
 }
@@ -153,30 +261,12 @@ RC BTLeafNode::insertAndSplit(int key, const RecordId& rid,
 RC BTLeafNode::locate(int searchKey, int& eid)
 { 
 	int key_count = getKeyCount();
+	const int* keys = (const int *) page();
 
-
-	leaf_entry* key_start = (leaf_entry *) (buffer + sizeof(int));
-
-	int i;
-	for (i = 0; i < key_count; i++)
-	{
-		if (key_start->ent_key == searchKey)
-		{
-			eid = i;
-			return 0;
-		}
-
-		if (key_start->ent_key > searchKey)
-		{
-			eid = i;
-			return RC_NO_SUCH_RECORD;
-		}
-
-		key_start++;
-	}
-
-	// if out of loop, iterated all entries & no match found
-	eid = i;
+	// the first entry that is not smaller than searchKey
+	eid = countKeys(keys, key_count, searchKey, false);
+	if (eid < key_count && keys[eid] == searchKey)
+		return 0;
 
 	return RC_NO_SUCH_RECORD;
 }
@@ -192,17 +282,70 @@ RC BTLeafNode::readEntry(int eid, int& key, RecordId& rid)
 { 
 	int key_count = getKeyCount();
 
-	leaf_entry* key_start = (leaf_entry*) (buffer + sizeof(int));
-
-	if (eid >= key_count)
+	if (eid < 0 || eid >= key_count)
 	{
 		return RC_NO_SUCH_RECORD;
 	}
 
-	leaf_entry* read_entry = key_start + eid;
+	int entries = getMaxKeyCount() + 1;
+	const int* keys = (const int *) page();
+	const int* sids = keys + entries;
+	const PageId* pids = (const PageId *) (sids + entries);
 
-	key = read_entry->ent_key;
-	rid = read_entry->rec_id;
+	key = keys[eid];
+	rid.pid = pids[eid];
+	rid.sid = sids[eid];
+
+	return 0;
+}
+
+/*
+ * Remove the eid entry from the node.
+ * @param eid[IN] the entry number to remove
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::remove(int eid)
+{
+	int key_count = getKeyCount();
+
+	if (eid < 0 || eid >= key_count)
+		return RC_NO_SUCH_RECORD;
+
+	makeWritable();
+	int entries = getMaxKeyCount() + 1;
+	int* keys = (int *) &buffer[0];
+	int* sids = keys + entries;
+	PageId* pids = (PageId *) (sids + entries);
+
+	// move the entries after eid one spot to the left
+	int rest = key_count - eid - 1;
+	memmove(keys + eid, keys + eid + 1, sizeof(int) * rest);
+	memmove(sids + eid, sids + eid + 1, sizeof(int) * rest);
+	memmove(pids + eid, pids + eid + 1, sizeof(PageId) * rest);
+
+	setKeyCount(key_count - 1);
+
+	return 0;
+}
+
+/*
+ * Set the RecordId of the eid entry, keeping its key.
+ * @param eid[IN] the entry number to update
+ * @param rid[IN] the new RecordId of the entry
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::setEntryRid(int eid, const RecordId& rid)
+{
+	if (eid < 0 || eid >= getKeyCount())
+		return RC_NO_SUCH_RECORD;
+
+	makeWritable();
+	int entries = getMaxKeyCount() + 1;
+	int* sids = (int *) &buffer[0] + entries;
+	PageId* pids = (PageId *) (sids + entries);
+
+	sids[eid] = rid.sid;
+	pids[eid] = rid.pid;
 
 	return 0;
 }
@@ -214,10 +357,10 @@ RC BTLeafNode::readEntry(int eid, int& key, RecordId& rid)
 PageId BTLeafNode::getNextNodePtr()
 { 
 	// stored at end of buffer 
-	// location buffer + PAGE_SIZE - sizeof(PageId)
-	int next_Id = PageFile::PAGE_SIZE - sizeof(PageId);
+	// location buffer + page size - sizeof(PageId)
+	int next_Id = pageSize - sizeof(PageId);
 	PageId siblingPg;
-	memcpy(&siblingPg, buffer + next_Id, sizeof(PageId));
+	memcpy(&siblingPg, page() + next_Id, sizeof(PageId));
 
 	return siblingPg; 
 }
@@ -229,13 +372,23 @@ PageId BTLeafNode::getNextNodePtr()
  */
 RC BTLeafNode::setNextNodePtr(PageId pid)
 { 
-	int next_Id = PageFile::PAGE_SIZE - sizeof(PageId);
-	memcpy(buffer + next_Id, &pid, sizeof(PageId));
+	makeWritable();
+	int next_Id = pageSize - sizeof(PageId);
+	memcpy(&buffer[0] + next_Id, &pid, sizeof(PageId));
 
 	// any possible errors?
 	return 0; 
 }
 
+/*
+ * Construct an empty node.
+ * @param pageSize[IN] the page size of the index file
+ */
+BTNonLeafNode::BTNonLeafNode(int pageSize)
+	: buffer(pageSize, 0), pageSize(pageSize)
+{
+}
+
 /*
  * Read the content of the node from the page pid in the PageFile pf.
  * @param pid[IN] the PageId to read
@@ -244,7 +397,22 @@ RC BTLeafNode::setNextNodePtr(PageId pid)
  */
 RC BTNonLeafNode::read(PageId pid, const PageFile& pf)
 { 
-	return pf.read(pid, buffer); 
+	handle.release();
+	pageSize = pf.getPageSize();
+	buffer.resize(pageSize);
+	return pf.read(pid, &buffer[0]); 
+}
+
+/*
+ * Wrap the page pid of the PageFile pf without copying it.
+ * The node cannot be modified until it is read() again.
+ * @param pid[IN] the PageId to view
+ * @param pf[IN] PageFile to view the page of
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::view(PageId pid, const PageFile& pf)
+{
+	return viewPage(pid, pf, handle, buffer, pageSize);
 }
     
 /*
@@ -255,7 +423,7 @@ RC BTNonLeafNode::read(PageId pid, const PageFile& pf)
  */
 RC BTNonLeafNode::write(PageId pid, PageFile& pf)
 { 
-	return pf.write(pid, buffer);
+	return pf.write(pid, page());
 }
 
 /*
@@ -265,10 +433,19 @@ RC BTNonLeafNode::write(PageId pid, PageFile& pf)
 int BTNonLeafNode::getKeyCount()
 { 
 	int key_count = 0;
-	memcpy(&key_count, &buffer, sizeof(int));
+	memcpy(&key_count, page() + pageSize - trailer_size, sizeof(int));
 
 	return key_count; }
 
+/*
+ * Set the number of keys stored in the node.
+ * @param count[IN] the number of keys
+ */
+void BTNonLeafNode::setKeyCount(int count)
+{
+	memcpy(&buffer[0] + pageSize - trailer_size, &count, sizeof(int));
+}
+
 
 /*
  * Insert a (key, pid) pair to the node.
@@ -278,37 +455,28 @@ int BTNonLeafNode::getKeyCount()
  */
 RC BTNonLeafNode::insert(int key, PageId pid)
 { 
+	makeWritable();
 	int key_count = getKeyCount();
 
-	if (key_count >= max_key_count + 1)
+	int entries = getMaxKeyCount() + 1;
+	if (key_count >= entries)
 		return RC_NODE_FULL;
 
-	entry_node* key_start = (entry_node *) (buffer + sizeof(int) + sizeof(PageId));
-	// keys start after the #keys int in the beginning of buffer
+	int* keys = (int *) &buffer[0];
+	PageId* ptrs = (PageId *) (keys + entries);
 
-	int i;
-	for (i = 0; i < key_count; i++)
-	{
-		if (key_start->ent_key > key)
-			break;
-		key_start++;
-	}
+	// the new key goes behind the same keys, with pid behind it
+	int i = countKeys(keys, key_count, key, true);
 
 	// need to move remaining entries one spot to the right to make space for insert
-	if (i < key_count)
-	{
-		int rest = key_count - i;
-		memmove(key_start+1, key_start, entry_size * rest);
-	}
-
-	entry_node new_entry;
-	new_entry.pag_id = pid;
-	new_entry.ent_key = key;
+	int rest = key_count - i;
+	memmove(keys + i + 1, keys + i, sizeof(int) * rest);
+	memmove(ptrs + i + 2, ptrs + i + 1, sizeof(PageId) * rest);
 
-	*key_start = new_entry;
+	keys[i] = key;
+	ptrs[i + 1] = pid;
 
-	key_count++; // after insert succeed, should increment;
-	memcpy(buffer,&key_count, sizeof(int)); // update
+	setKeyCount(key_count + 1); // after insert succeed, should increment
 
 	return 0; 
  }
@@ -331,25 +499,29 @@ RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, in
 	int key_count = getKeyCount();
 
 	int front_half = (key_count) / 2;
-	int back_half = (key_count)/ 2 - 1;
+	int back_half = key_count - front_half - 1; // the middle key moves up
 
-	entry_node* key_start = (entry_node*) (buffer + sizeof(int) + sizeof(PageId));
-	entry_node* split_point = key_start + front_half;
+	int entries = getMaxKeyCount() + 1;
+	int* keys = (int *) &buffer[0];
+	PageId* ptrs = (PageId *) (keys + entries);
 
-	entry_node* sib_key_start = (entry_node*) (sibling.buffer + sizeof(int) + sizeof(PageId));
-	midKey = split_point->ent_key;
+	sibling.makeWritable();
+	int* sib_keys = (int *) &sibling.buffer[0];
+	PageId* sib_ptrs = (PageId *) (sib_keys + sibling.getMaxKeyCount() + 1);
+	midKey = keys[front_half];
 
-	PageId* sib_ptr_start = (PageId*) (sibling.buffer + sizeof(int));
-	PageId sibFirstPtr = split_point->pag_id;
-
-	*sib_ptr_start = sibFirstPtr;
+	// the pointer behind the middle key becomes the first of the sibling
+	sib_ptrs[0] = ptrs[front_half + 1];
 	
 	// copy backhalf into siblings buffer
-	memcpy(sib_key_start, ++split_point, sizeof(entry_node) * back_half );
-	memcpy(sibling.buffer, &back_half, sizeof(int)); // update key_count in sibling buffer
-	memcpy(buffer, &front_half, sizeof(int));
+	memcpy(sib_keys, keys + front_half + 1, sizeof(int) * back_half);
+	memcpy(sib_ptrs + 1, ptrs + front_half + 2, sizeof(PageId) * back_half);
+	sibling.setKeyCount(back_half); // update key_count in sibling buffer
+	setKeyCount(front_half);
 
-	memset(split_point, '\0', sizeof(entry_node) * (back_half + 1)); // clear out the back half of the buffer
+	// clear out the middle key and the back half of the buffer
+	memset(keys + front_half, '\0', sizeof(int) * (back_half + 1));
+	memset(ptrs + front_half + 1, '\0', sizeof(PageId) * (back_half + 1));
 
 	return 0;  }
 
@@ -364,43 +536,39 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
 { 
 	int key_count = getKeyCount();
 
-	entry_node * key_start = (entry_node*) (buffer + sizeof(int) + sizeof(PageId));
-	PageId* firstptr = (PageId *) (buffer + sizeof(int));
+	const int* keys = (const int *) page();
+	const PageId* ptrs = (const PageId *) (keys + getMaxKeyCount() + 1);
 
-	if (key_start->ent_key > searchKey) {
-		pid = *firstptr;
-		return 0;
-	}
+	// follow the pointer behind the last smaller key,
+	// or behind the first key equal to searchKey
+	int i = countKeys(keys, key_count, searchKey, false);
+	if (i < key_count && keys[i] == searchKey)
+		i++;
 
-	int i;
-	for (i = 0; i < key_count; i++){
-		if (key_start->ent_key == searchKey)
-		{
-			pid = key_start->pag_id;
-			return 0;
-		}
-
-		if (key_start->ent_key < searchKey)
-		{
-			if (i == key_count-1)
-			{
-				pid = key_start->pag_id;
-				return 0;
-			}
-		}
-		if ((key_start+1)->ent_key > searchKey)
-		{
-			pid = key_start->pag_id;
-			return 0;
-		}
-
-
-   		key_start++;
-   	}
-   	
-   	return RC_NO_SUCH_RECORD;
+	pid = ptrs[i];
+	return 0;
  }
 
+/*
+ * Read the eid-th child-node pointer.
+ * @param eid[IN] the number of the pointer to read
+ * @param pid[OUT] the pointer to the child node
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::readChildPtr(int eid, PageId& pid)
+{
+	if (eid < 0 || eid > getKeyCount())
+	{
+		return RC_NO_SUCH_RECORD;
+	}
+
+	const int* keys = (const int *) page();
+	const PageId* ptrs = (const PageId *) (keys + getMaxKeyCount() + 1);
+
+	pid = ptrs[eid];
+	return 0;
+}
+
 /*
  * Initialize the root node with (pid1, key, pid2).
  * @param pid1[IN] the first PageId to insert
@@ -410,23 +578,37 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
  */
 RC BTNonLeafNode::initializeRoot(PageId pid1, int key, PageId pid2)
 { 
-	int key_count = 0;
+	makeWritable();
 
-	entry_node* key_start = (entry_node *) (buffer + sizeof(int)+ sizeof(PageId));
-	// keys start after the #keys int in the beginning of buffer
-	PageId * first = (PageId*) (buffer + sizeof(int));
-	entry_node new_entry;
-	new_entry.pag_id = pid2;
-	new_entry.ent_key = key;
+	int* keys = (int *) &buffer[0];
+	PageId* ptrs = (PageId *) (keys + getMaxKeyCount() + 1);
 
-	*key_start = new_entry;
+	keys[0] = key;
+	ptrs[0] = pid1;
+	ptrs[1] = pid2;
 
-	key_count++; // after insert succeed, should increment;
-	memcpy(buffer,&key_count, sizeof(int)); // update
+	setKeyCount(1);
 
-	*first = pid1;
-	
+	return 0; }
 
-	
+/*
+ * Copy the viewed page into the node buffer before the node is modified.
+ */
+void BTLeafNode::makeWritable()
+{
+	if (!handle.empty()) {
+		buffer.assign(handle.data(), handle.data() + pageSize);
+		handle.release();
+	}
+}
 
-	return 0; }
+/*
+ * Copy the viewed page into the node buffer before the node is modified.
+ */
+void BTNonLeafNode::makeWritable()
+{
+	if (!handle.empty()) {
+		buffer.assign(handle.data(), handle.data() + pageSize);
+		handle.release();
+	}
+}
@@ -4,27 +4,29 @@
 
 #include "RecordFile.h"
 #include "PageFile.h"
+#include "PageHandle.h"
 #include <stdio.h>
 #include <cstring>
+#include <vector>
 
-typedef struct {
-    int ent_key;
-    RecordId rec_id;
-} leaf_entry;
-
-typedef struct {
-    int ent_key;
-    PageId pag_id;
-} entry_node;
+// a node keeps its sorted keys in an array at the start of the page,
+// apart from the record ids or child pointers, so that a search reads
+// only the keys, from consecutive cache lines. # keys and the pointer
+// to the next leaf are kept at the end of the page
 
 /**
  * BTLeafNode: The class representing a B+tree leaf node.
  */
 class BTLeafNode {
   public:
-    static const int entry_size = sizeof(leaf_entry);
-    static const int max_key_count = (PageFile::PAGE_SIZE - sizeof(int) - sizeof(PageId)) / entry_size - 1;
-    static const int nonEntry_size = sizeof(entry_node);
+    static const int entry_size = 2 * sizeof(int) + sizeof(PageId);  // key, sid and pid of an entry
+    static const int trailer_size = 2 * sizeof(PageId);  // #keys padded, and the next leaf
+
+   /**
+    * Construct an empty node.
+    * @param pageSize[IN] the page size of the index file
+    */
+    BTLeafNode(int pageSize = PageFile::DEFAULT_PAGE_SIZE);
 
    /**
     * Insert the (key, rid) pair to the node.
@@ -70,6 +72,22 @@ class BTLeafNode {
     */
     RC readEntry(int eid, int& key, RecordId& rid);
 
+   /**
+    * Remove the eid entry from the node. The entries after it move
+    * one spot to the left.
+    * @param eid[IN] the entry number to remove
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC remove(int eid);
+
+   /**
+    * Set the RecordId of the eid entry, keeping its key.
+    * @param eid[IN] the entry number to update
+    * @param rid[IN] the new RecordId of the entry
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC setEntryRid(int eid, const RecordId& rid);
+
    /**
     * Return the pid of the next slibling node.
     * @return the PageId of the next sibling node 
@@ -89,6 +107,13 @@ class BTLeafNode {
     * @return the number of keys in the node
     */
     int getKeyCount();
+
+   /**
+    * Return the number of keys the node can hold, which depends on
+    * the page size.
+    * @return the max number of keys in the node
+    */
+    int getMaxKeyCount() const { return (pageSize - trailer_size) / entry_size - 1; }
  
    /**
     * Read the content of the node from the page pid in the PageFile pf.
@@ -97,6 +122,17 @@ class BTLeafNode {
     * @return 0 if successful. Return an error code if there is an error.
     */
     RC read(PageId pid, const PageFile& pf);
+
+   /**
+    * Wrap the page pid in the PageFile pf as the content of the node
+    * without copying it. The page stays pinned in the buffer pool until
+    * the node is read again or destroyed. Modifying the node makes a
+    * private copy of the page first.
+    * @param pid[IN] the PageId to view
+    * @param pf[IN] PageFile to view the page of
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC view(PageId pid, const PageFile& pf);
     
    /**
     * Write the content of the node to the page pid in the PageFile pf.
@@ -109,15 +145,24 @@ class BTLeafNode {
   private:
    /**
     * The main memory buffer for loading the content of the disk page 
-    * that contains the node.
+    * that contains the node. It is empty while the node views a page.
     */
-    char buffer[PageFile::PAGE_SIZE];
+    std::vector<char> buffer;
+    int pageSize;
     PageId currPid;
 
+   /**
+    * The pinned page wrapped by view(). If the handle is empty,
+    * the content of the node is in the buffer.
+    */
+    PageHandle handle;
+
+    const char* page() const { return handle.empty() ? &buffer[0] : handle.data(); }
+    void makeWritable();
+    void setKeyCount(int count);
+
     //BTLeafNode* sibling;
     //PageId node_pg;
-
-    //int entry_size = sizeof(leaf_entry);
 }; 
 
 
@@ -126,9 +171,14 @@ class BTLeafNode {
  */
 class BTNonLeafNode {
   public:
-    static const int entry_size = sizeof(leaf_entry);
-    static const int max_key_count = (PageFile::PAGE_SIZE - sizeof(int) - sizeof(PageId)) / entry_size - 1;
-    static const int nonEntry_size = sizeof(entry_node);
+    static const int entry_size = sizeof(int) + sizeof(PageId);  // key and pid of an entry
+    static const int trailer_size = 2 * sizeof(PageId);  // #keys padded, and a spare PageId
+
+   /**
+    * Construct an empty node.
+    * @param pageSize[IN] the page size of the index file
+    */
+    BTNonLeafNode(int pageSize = PageFile::DEFAULT_PAGE_SIZE);
 
    /**
     * Insert a (key, pid) pair to the node.
@@ -163,6 +213,15 @@ class BTNonLeafNode {
     */
     RC locateChildPtr(int searchKey, PageId& pid);
 
+   /**
+    * Read the eid-th child-node pointer. A node with n keys has n + 1
+    * pointers, and the pointer eid is in front of the key eid.
+    * @param eid[IN] the number of the pointer to read
+    * @param pid[OUT] the pointer to the child node
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC readChildPtr(int eid, PageId& pid);
+
    /**
     * Initialize the root node with (pid1, key, pid2).
     * @param pid1[IN] the first PageId to insert
@@ -178,6 +237,13 @@ class BTNonLeafNode {
     */
     int getKeyCount();
 
+   /**
+    * Return the number of keys the node can hold, which depends on
+    * the page size.
+    * @return the max number of keys in the node
+    */
+    int getMaxKeyCount() const { return (((pageSize - trailer_size - (int) sizeof(PageId)) / entry_size) & ~1) - 1; }
+
    /**
     * Read the content of the node from the page pid in the PageFile pf.
     * @param pid[IN] the PageId to read
@@ -185,6 +251,17 @@ class BTNonLeafNode {
     * @return 0 if successful. Return an error code if there is an error.
     */
     RC read(PageId pid, const PageFile& pf);
+
+   /**
+    * Wrap the page pid in the PageFile pf as the content of the node
+    * without copying it. The page stays pinned in the buffer pool until
+    * the node is read again or destroyed. Modifying the node makes a
+    * private copy of the page first.
+    * @param pid[IN] the PageId to view
+    * @param pf[IN] PageFile to view the page of
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC view(PageId pid, const PageFile& pf);
     
    /**
     * Write the content of the node to the page pid in the PageFile pf.
@@ -197,9 +274,20 @@ class BTNonLeafNode {
   private:
    /**
     * The main memory buffer for loading the content of the disk page 
-    * that contains the node.
+    * that contains the node. It is empty while the node views a page.
     */
-    char buffer[PageFile::PAGE_SIZE];
+    std::vector<char> buffer;
+    int pageSize;
+
+   /**
+    * The pinned page wrapped by view(). If the handle is empty,
+    * the content of the node is in the buffer.
+    */
+    PageHandle handle;
+
+    const char* page() const { return handle.empty() ? &buffer[0] : handle.data(); }
+    void makeWritable();
+    void setKeyCount(int count);
 }; 
 
 #endif /* BTREENODE_H */
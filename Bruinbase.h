@@ -18,5 +18,11 @@ const int RC_INVALID_CURSOR      = -1011;
 const int RC_NO_SUCH_RECORD      = -1012;
 const int RC_END_OF_TREE         = -1013;
 const int RC_INVALID_ATTRIBUTE   = -1014;
+const int RC_PAGE_PINNED         = -1015;
+const int RC_POOL_EXHAUSTED      = -1016;
+const int RC_OUT_OF_MEMORY       = -1017;
+const int RC_FILE_MAP_FAILED     = -1018;
+const int RC_INVALID_PAGE_SIZE   = -1019;
+const int RC_END_OF_FILE         = -1020;
 
 #endif // BRUINBASE_H
@@ -0,0 +1,724 @@
+#include "Bruinbase.h"
+#include "BufferPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+int BufferPool::frameCount = 0;
+BufferPool::Frame* BufferPool::frames = NULL;
+size_t BufferPool::budget = 0;
+size_t BufferPool::usedBytes = 0;
+size_t BufferPool::unloggedBytes = 0;
+BufferPool::Queue BufferPool::queues[BufferPool::QUEUE_COUNT];
+BufferPool::List BufferPool::loggedList;
+BufferPool::List BufferPool::unloggedList;
+int* BufferPool::frameHash = NULL;
+int BufferPool::hashMask = 0;
+int BufferPool::ghostCount = 0;
+BufferPool::Ghost* BufferPool::ghosts = NULL;
+int BufferPool::ghostTail = 0;
+int* BufferPool::ghostHash = NULL;
+pthread_mutex_t BufferPool::lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t BufferPool::loadDone = PTHREAD_COND_INITIALIZER;
+pthread_cond_t BufferPool::writeDone = PTHREAD_COND_INITIALIZER;
+
+// the pool never gets smaller than this many pages of the largest size,
+// so that a few pages can always be pinned at the same time
+static const int MIN_FRAME_COUNT = 16;
+
+// the share of the frames A1in may keep before it has to give up its
+// pages, and the # pages remembered by A1out (relative to # frames).
+// these are the values recommended by the authors of 2Q.
+static const int A1IN_PERCENT  = 25;
+static const int A1OUT_PERCENT = 50;
+
+RC BufferPool::init(size_t bytes)
+{
+  RC rc;
+
+  pthread_mutex_lock(&lock);
+  rc = allocate(bytes);
+  pthread_mutex_unlock(&lock);
+
+  return rc;
+}
+
+RC BufferPool::allocate(size_t bytes)
+{
+  RC rc;
+
+  // the pool can hold at least MIN_FRAME_COUNT pages of the largest size
+  if (bytes < (size_t) MIN_FRAME_COUNT * PageFile::MAX_PAGE_SIZE) {
+    bytes = (size_t) MIN_FRAME_COUNT * PageFile::MAX_PAGE_SIZE;
+  }
+
+  // release the previous pool. its pages must not be in use
+  for (int i = 0; i < frameCount; i++) {
+    if (frames[i].pinCount > 0) return RC_PAGE_PINNED;
+  }
+  for (int i = 0; i < frameCount; i++) {
+    if (frames[i].dirty && (rc = writeBack(i)) < 0) return rc;
+  }
+  for (int i = 0; i < frameCount; i++) free(frames[i].data);
+  delete [] frames;
+  delete [] frameHash;
+  delete [] ghosts;
+  delete [] ghostHash;
+  frames = NULL;
+  frameCount = 0;
+
+  // there are enough frame descriptors to fill the budget with pages of
+  // the smallest size. the memory of a frame is only allocated when the
+  // frame is used for the first time
+  int count = bytes / PageFile::MIN_PAGE_SIZE;
+  budget = bytes;
+  usedBytes = 0;
+  unloggedBytes = 0;
+
+  for (int q = 0; q < QUEUE_COUNT; q++) {
+    queues[q].head = queues[q].tail = -1;
+    queues[q].count = 0;
+    queues[q].bytes = 0;
+  }
+  loggedList.head = loggedList.tail = -1;
+  unloggedList.head = unloggedList.tail = -1;
+  frames = new Frame[count];
+  for (int i = 0; i < count; i++) {
+    frames[i].fd = -1;
+    frames[i].pid = 0;
+    frames[i].pinCount = 0;
+    frames[i].valid = false;
+    frames[i].loading = false;
+    frames[i].dirty = false;
+    frames[i].unlogged = false;
+    frames[i].writing = false;
+    frames[i].recLsn = -1;
+    frames[i].logPrev = frames[i].logNext = -1;
+    frames[i].unloggedPrev = frames[i].unloggedNext = -1;
+    frames[i].size = 0;
+    frames[i].data = NULL;
+    frames[i].hashNext = -1;
+    enqueue(EMPTY, i);
+  }
+  frameCount = count;
+
+  // the hash tables have at least as many buckets as there are frames
+  for (hashMask = 1; hashMask < count; hashMask <<= 1);
+  frameHash = new int[hashMask];
+  ghostHash = new int[hashMask];
+  for (int i = 0; i < hashMask; i++) frameHash[i] = ghostHash[i] = -1;
+  hashMask--;
+
+  ghostCount = (int) ((long long) count * A1OUT_PERCENT / 100);
+  ghosts = new Ghost[ghostCount];
+  for (int i = 0; i < ghostCount; i++) {
+    ghosts[i].fd = -1;
+    ghosts[i].hashNext = -1;
+  }
+  ghostTail = 0;
+
+  return 0;
+}
+
+RC BufferPool::pin(int fd, PageId pid, int size, Frame*& frame)
+{
+  RC  rc;
+  int f;
+
+  pthread_mutex_lock(&lock);
+
+  // the pool gets the default size unless init() was called at startup
+  if (frames == NULL && (rc = allocate(DEFAULT_POOL_SIZE)) < 0) {
+    pthread_mutex_unlock(&lock);
+    return rc;
+  }
+
+  for (;;) {
+    //
+    // if the page is in the pool, pin its frame.
+    // a hit in Am makes the page the most recently used one,
+    // while a hit in A1in does not change its position in the FIFO.
+    //
+    if ((f = lookupFrame(fd, pid)) >= 0) {
+      frame = &frames[f];
+      if (frame->queue == AM) {
+        dequeue(f);
+        enqueue(AM, f);
+      }
+      frame->pinCount++;
+
+      // wait while another thread loads the page.
+      // if that thread failed to load the page, this thread has to.
+      while (frame->loading) pthread_cond_wait(&loadDone, &lock);
+      if (!frame->valid) frame->loading = true;
+
+      pthread_mutex_unlock(&lock);
+      return 0;
+    }
+
+    //
+    // find a frame for the page: a free frame, an unused frame descriptor
+    // while the budget allows, or the frame of an evicted page
+    //
+    if (queues[FREE].count > 0) {
+      f = queues[FREE].head;
+      dequeue(f);
+    } else if (queues[EMPTY].count > 0 && usedBytes + size <= budget) {
+      f = queues[EMPTY].head;
+      dequeue(f);
+    } else if ((f = evict()) < 0) {
+      pthread_mutex_unlock(&lock);
+      return f;
+    }
+
+    // make sure the frame has memory for the page
+    if ((rc = reserve(f, size)) < 0) {
+      enqueue(frames[f].size > 0 ? FREE : EMPTY, f);
+      pthread_mutex_unlock(&lock);
+      return rc;
+    }
+
+    // evicting a dirty page releases the lock while the page is written
+    // back, so another thread may have brought the page in meanwhile
+    if (lookupFrame(fd, pid) < 0) break;
+    enqueue(FREE, f);
+  }
+
+  // a page that was recently pushed out of A1in goes to Am
+  frame = &frames[f];
+  frame->fd = fd;
+  frame->pid = pid;
+  frame->pinCount = 1;
+  frame->valid = false;
+  frame->loading = true;
+  frame->dirty = false;
+  frame->unlogged = false;
+  frame->writing = false;
+  frame->recLsn = -1;
+  enqueue(removeGhost(fd, pid) ? AM : A1IN, f);
+
+  int h = hash(fd, pid);
+  frame->hashNext = frameHash[h];
+  frameHash[h] = f;
+
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+void BufferPool::pin(Frame* frame)
+{
+  pthread_mutex_lock(&lock);
+  frame->pinCount++;
+  pthread_mutex_unlock(&lock);
+}
+
+void BufferPool::validate(Frame* frame)
+{
+  pthread_mutex_lock(&lock);
+  frame->valid = true;
+  frame->loading = false;
+  pthread_cond_broadcast(&loadDone);
+  pthread_mutex_unlock(&lock);
+}
+
+void BufferPool::unpin(Frame* frame, bool dirty)
+{
+  pthread_mutex_lock(&lock);
+  if (dirty) frame->dirty = true;
+  frame->pinCount--;
+
+  // if the page was never loaded, let a waiting thread try to load it.
+  // the frame goes back to the free frames when nobody waits for it.
+  if (!frame->valid) {
+    frame->loading = false;
+    pthread_cond_broadcast(&loadDone);
+    if (frame->pinCount == 0) release(frame - frames);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void BufferPool::setUnlogged(Frame* frame)
+{
+  pthread_mutex_lock(&lock);
+
+  // the page must not change while it is written back
+  while (frame->writing) pthread_cond_wait(&writeDone, &lock);
+  if (!frame->unlogged) {
+    frame->unlogged = true;
+    unloggedBytes += frame->size;
+    link(unloggedList, &Frame::unloggedPrev, &Frame::unloggedNext, frame - frames);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void BufferPool::takeUnlogged(std::vector<Frame*>& list)
+{
+  pthread_mutex_lock(&lock);
+  while (unloggedList.head >= 0) {
+    int f = unloggedList.head;
+    unlink(unloggedList, &Frame::unloggedPrev, &Frame::unloggedNext, f);
+    frames[f].pinCount++;
+    frames[f].unlogged = false;
+    unloggedBytes -= frames[f].size;
+    list.push_back(&frames[f]);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void BufferPool::setRecLsn(Frame* frame, long long lsn)
+{
+  pthread_mutex_lock(&lock);
+
+  // the log grows in the order of the LSNs, so the frame that gets
+  // the latest LSN goes to the tail of the list
+  clearRecLsn(frame - frames);
+  frame->recLsn = lsn;
+  if (lsn >= 0) link(loggedList, &Frame::logPrev, &Frame::logNext, frame - frames);
+  pthread_mutex_unlock(&lock);
+}
+
+long long BufferPool::getMinRecLsn()
+{
+  long long lsn = -1;
+
+  pthread_mutex_lock(&lock);
+  if (loggedList.head >= 0) lsn = frames[loggedList.head].recLsn;
+  pthread_mutex_unlock(&lock);
+
+  return lsn;
+}
+
+RC BufferPool::writeBackLogged()
+{
+  RC rc;
+  std::vector<Page> dirty;
+
+  // collect the dirty pages in the order of their files and pages
+  pthread_mutex_lock(&lock);
+  for (int f = loggedList.head; f >= 0; f = frames[f].logNext) {
+    if (frames[f].dirty && !frames[f].unlogged) {
+      Page page = { frames[f].fd, frames[f].pid };
+      dirty.push_back(page);
+    }
+  }
+  std::sort(dirty.begin(), dirty.end());
+
+  rc = writeBackPages(dirty, false);
+  pthread_mutex_unlock(&lock);
+
+  return rc;
+}
+
+size_t BufferPool::getUnloggedBytes()
+{
+  size_t bytes;
+
+  pthread_mutex_lock(&lock);
+  bytes = unloggedBytes;
+  pthread_mutex_unlock(&lock);
+
+  return bytes;
+}
+
+RC BufferPool::flush(Frame* frame)
+{
+  RC rc;
+
+  pthread_mutex_lock(&lock);
+  rc = writeBack(frame - frames);
+  pthread_mutex_unlock(&lock);
+
+  return rc;
+}
+
+RC BufferPool::flushFile(int fd)
+{
+  RC rc;
+  std::vector<Page> dirty;
+
+  // collect the dirty pages of the file in order. a dirty page is either
+  // unlogged or has the LSN of its last image
+  pthread_mutex_lock(&lock);
+  for (int f = unloggedList.head; f >= 0; f = frames[f].unloggedNext) {
+    if (frames[f].fd == fd && frames[f].dirty) {
+      Page page = { fd, frames[f].pid };
+      dirty.push_back(page);
+    }
+  }
+  for (int f = loggedList.head; f >= 0; f = frames[f].logNext) {
+    if (frames[f].fd == fd && frames[f].dirty && !frames[f].unlogged) {
+      Page page = { fd, frames[f].pid };
+      dirty.push_back(page);
+    }
+  }
+  std::sort(dirty.begin(), dirty.end());
+
+  rc = writeBackPages(dirty, true);
+  pthread_mutex_unlock(&lock);
+
+  return rc;
+}
+
+void BufferPool::evictFile(int fd)
+{
+  pthread_mutex_lock(&lock);
+
+  for (int i = 0; i < frameCount; i++) {
+    if (frames[i].fd == fd) {
+      // an asynchronous read may still be filling the frame,
+      // and another thread may be writing it back
+      while (frames[i].loading && frames[i].fd == fd) {
+        pthread_cond_wait(&loadDone, &lock);
+      }
+      while (frames[i].writing && frames[i].fd == fd) {
+        pthread_cond_wait(&writeDone, &lock);
+      }
+      if (frames[i].fd != fd) continue;
+      frames[i].pinCount = 0;
+      frames[i].valid = false;
+      frames[i].loading = false;
+      release(i);
+    }
+  }
+
+  // the file descriptor may be reused by another file,
+  // so the pages of this file must not be remembered either
+  for (int i = 0; i < ghostCount; i++) {
+    if (ghosts[i].fd == fd) removeGhost(fd, ghosts[i].pid);
+  }
+
+  pthread_mutex_unlock(&lock);
+}
+
+//
+// private helper functions. the caller must hold the lock. the functions
+// that write back pages release it while they write.
+//
+
+RC BufferPool::writeBack(int f)
+{
+  if (!frames[f].dirty) return 0;
+  return writeBackRun(&f, 1);
+}
+
+RC BufferPool::writeBackCluster(int f)
+{
+  int    run[PageFile::MAX_IO_RUN];
+  int    fd = frames[f].fd;
+  PageId first = frames[f].pid;
+  PageId last = frames[f].pid;
+  int    g;
+
+  // extend the run over the unpinned dirty pages before and after the page
+  while (last - first + 1 < PageFile::MAX_IO_RUN && first > 0) {
+    g = lookupFrame(fd, first - 1);
+    if (g < 0 || !frames[g].dirty || frames[g].pinCount > 0 || frames[g].unlogged) break;
+    first--;
+  }
+  while (last - first + 1 < PageFile::MAX_IO_RUN) {
+    g = lookupFrame(fd, last + 1);
+    if (g < 0 || !frames[g].dirty || frames[g].pinCount > 0 || frames[g].unlogged) break;
+    last++;
+  }
+
+  for (PageId pid = first; pid <= last; pid++) {
+    run[pid - first] = (pid == frames[f].pid) ? f : lookupFrame(fd, pid);
+  }
+  return writeBackRun(run, (int) (last - first + 1));
+}
+
+RC BufferPool::writeBackRun(int* f, int count)
+{
+  RC     rc;
+  char*  pages[PageFile::MAX_IO_RUN];
+  int    fd = frames[f[0]].fd;
+  PageId pid = frames[f[0]].pid;
+  int    size = frames[f[0]].size;
+
+  // the frames hold adjacent pages of one file. they are written without
+  // the lock; pinning them keeps them in the pool, and setUnlogged() keeps
+  // them from changing until the write is done
+  for (int i = 0; i < count; i++) {
+    frames[f[i]].pinCount++;
+    frames[f[i]].writing = true;
+    pages[i] = frames[f[i]].data;
+  }
+  pthread_mutex_unlock(&lock);
+  rc = PageFile::writeBack(fd, pid, size, pages, count);
+  pthread_mutex_lock(&lock);
+
+  // the frames stay dirty if the write failed
+  for (int i = 0; i < count; i++) {
+    frames[f[i]].pinCount--;
+    frames[f[i]].writing = false;
+    if (rc == 0) {
+      frames[f[i]].dirty = false;
+      clearRecLsn(f[i]);
+    }
+  }
+  pthread_cond_broadcast(&writeDone);
+
+  return rc;
+}
+
+RC BufferPool::writeBackPages(const std::vector<Page>& pages, bool all)
+{
+  RC       rc;
+  unsigned i = 0;
+
+  // the frames are looked up again for each run, since they may have been
+  // written back or evicted while the lock was released for a write
+  while (i < pages.size()) {
+    int run[PageFile::MAX_IO_RUN];
+    int n = 0;
+
+    while (i < pages.size() && n < PageFile::MAX_IO_RUN) {
+      int f = lookupFrame(pages[i].fd, pages[i].pid);
+
+      // a page that another thread is writing back is waited for if all
+      // pages have to reach the file, and skipped otherwise
+      if (f >= 0 && frames[f].writing && all) {
+        if (n > 0) break;
+        pthread_cond_wait(&writeDone, &lock);
+        continue;
+      }
+
+      // only the unpinned pages whose changes are logged, unless all
+      // pages are written back
+      bool write = f >= 0 && frames[f].dirty && !frames[f].writing &&
+                   (all || (frames[f].pinCount == 0 && !frames[f].unlogged));
+      if (n > 0 && (!write || pages[i].fd != frames[run[0]].fd ||
+                    pages[i].pid != frames[run[0]].pid + n)) break;
+      if (write) run[n++] = f;
+      i++;
+    }
+
+    if (n > 0 && (rc = writeBackRun(run, n)) < 0) return rc;
+  }
+
+  return 0;
+}
+
+int BufferPool::hash(int fd, PageId pid)
+{
+  unsigned long long h = ((unsigned long long) fd << 32) ^ (unsigned long long) pid;
+
+  // mix the bits so that consecutive pages spread over the buckets
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return (int) (h & hashMask);
+}
+
+int BufferPool::lookupFrame(int fd, PageId pid)
+{
+  int f = frameHash[hash(fd, pid)];
+  while (f >= 0 && (frames[f].fd != fd || frames[f].pid != pid)) {
+    f = frames[f].hashNext;
+  }
+  return f;
+}
+
+void BufferPool::unhashFrame(int f)
+{
+  int* link = &frameHash[hash(frames[f].fd, frames[f].pid)];
+  while (*link != f) link = &frames[*link].hashNext;
+  *link = frames[f].hashNext;
+  frames[f].hashNext = -1;
+}
+
+bool BufferPool::removeGhost(int fd, PageId pid)
+{
+  int* link = &ghostHash[hash(fd, pid)];
+  while (*link >= 0) {
+    Ghost* g = &ghosts[*link];
+    if (g->fd == fd && g->pid == pid) {
+      *link = g->hashNext;
+      g->fd = -1;
+      g->hashNext = -1;
+      return true;
+    }
+    link = &g->hashNext;
+  }
+  return false;
+}
+
+void BufferPool::addGhost(int fd, PageId pid)
+{
+  if (ghostCount == 0) return;
+
+  // the oldest ghost in the ring is forgotten
+  Ghost* g = &ghosts[ghostTail];
+  if (g->fd >= 0) removeGhost(g->fd, g->pid);
+
+  int h = hash(fd, pid);
+  g->fd = fd;
+  g->pid = pid;
+  g->hashNext = ghostHash[h];
+  ghostHash[h] = ghostTail;
+
+  ghostTail = (ghostTail + 1) % ghostCount;
+}
+
+void BufferPool::enqueue(int q, int f)
+{
+  frames[f].queue = q;
+  queues[q].bytes += frames[f].size;
+  frames[f].prev = queues[q].tail;
+  frames[f].next = -1;
+  if (queues[q].tail >= 0) frames[queues[q].tail].next = f;
+  else queues[q].head = f;
+  queues[q].tail = f;
+  queues[q].count++;
+}
+
+void BufferPool::dequeue(int f)
+{
+  Queue& q = queues[frames[f].queue];
+  if (frames[f].prev >= 0) frames[frames[f].prev].next = frames[f].next;
+  else q.head = frames[f].next;
+  if (frames[f].next >= 0) frames[frames[f].next].prev = frames[f].prev;
+  else q.tail = frames[f].prev;
+  q.count--;
+  q.bytes -= frames[f].size;
+}
+
+void BufferPool::link(List& list, int Frame::* prev, int Frame::* next, int f)
+{
+  frames[f].*prev = list.tail;
+  frames[f].*next = -1;
+  if (list.tail >= 0) frames[list.tail].*next = f;
+  else list.head = f;
+  list.tail = f;
+}
+
+void BufferPool::unlink(List& list, int Frame::* prev, int Frame::* next, int f)
+{
+  if (frames[f].*prev >= 0) frames[frames[f].*prev].*next = frames[f].*next;
+  else list.head = frames[f].*next;
+  if (frames[f].*next >= 0) frames[frames[f].*next].*prev = frames[f].*prev;
+  else list.tail = frames[f].*prev;
+  frames[f].*prev = frames[f].*next = -1;
+}
+
+void BufferPool::clearRecLsn(int f)
+{
+  // a page without a recLsn is not in the list ordered by recLsn
+  if (frames[f].recLsn < 0) return;
+  unlink(loggedList, &Frame::logPrev, &Frame::logNext, f);
+  frames[f].recLsn = -1;
+}
+
+int BufferPool::findVictim(int q)
+{
+  // the first frame from the head of the queue that is not pinned
+  // and does not hold changes missing from the log
+  int f = queues[q].head;
+  while (f >= 0 && (frames[f].pinCount > 0 || frames[f].unlogged)) f = frames[f].next;
+  return f;
+}
+
+int BufferPool::evict()
+{
+  RC  rc;
+  int f;
+
+  for (;;) {
+    // take the page out of A1in while A1in holds more than its share
+    // of the memory, and out of Am otherwise
+    f = -1;
+    if (queues[A1IN].bytes > budget / 100 * A1IN_PERCENT || queues[AM].count == 0) {
+      f = findVictim(A1IN);
+    }
+    if (f < 0) f = findVictim(AM);
+    if (f < 0) f = findVictim(A1IN);
+    if (f < 0) return RC_POOL_EXHAUSTED;
+    if (!frames[f].dirty) break;
+
+    // write back the evicted page together with the dirty pages next to
+    // it. the page may be in use again once the write is done, so the
+    // victim is chosen anew
+    if ((rc = writeBackCluster(f)) < 0) return rc;
+  }
+
+  // remember the pages pushed out of A1in in A1out
+  if (frames[f].queue == A1IN) addGhost(frames[f].fd, frames[f].pid);
+  unhashFrame(f);
+  dequeue(f);
+  clearRecLsn(f);
+  frames[f].fd = -1;
+  frames[f].pid = 0;
+
+  return f;
+}
+
+RC BufferPool::reserve(int f, int size)
+{
+  int    g;
+  void*  memory;
+  size_t alignment;
+
+  if (frames[f].size == size) return 0;
+  freeMemory(f);
+
+  // take the memory of free frames and then of evicted pages
+  // until the page fits in the budget
+  while (usedBytes + size > budget) {
+    if (queues[FREE].count > 0) {
+      g = queues[FREE].head;
+      dequeue(g);
+    } else if ((g = evict()) < 0) {
+      return g;
+    }
+
+    // memory of the right size is handed over as it is
+    if (frames[g].size == size) {
+      frames[f].data = frames[g].data;
+      frames[f].size = size;
+      frames[g].data = NULL;
+      frames[g].size = 0;
+      enqueue(EMPTY, g);
+      return 0;
+    }
+    freeMemory(g);
+    enqueue(EMPTY, g);
+  }
+
+  alignment = ((size_t) size < FRAME_ALIGNMENT) ? (size_t) size : FRAME_ALIGNMENT;
+  if (posix_memalign(&memory, alignment, size) != 0) {
+    return RC_OUT_OF_MEMORY;
+  }
+  frames[f].data = (char*) memory;
+  frames[f].size = size;
+  usedBytes += size;
+
+  return 0;
+}
+
+void BufferPool::freeMemory(int f)
+{
+  free(frames[f].data);
+  usedBytes -= frames[f].size;
+  frames[f].data = NULL;
+  frames[f].size = 0;
+}
+
+void BufferPool::release(int f)
+{
+  // remove the frame from the hash table and its queue
+  // and return it to the free frames
+  if (frames[f].queue == FREE || frames[f].queue == EMPTY) return;
+  unhashFrame(f);
+  dequeue(f);
+  frames[f].fd = -1;
+  frames[f].pid = 0;
+  frames[f].dirty = false;
+  clearRecLsn(f);
+  if (frames[f].unlogged) {
+    frames[f].unlogged = false;
+    unloggedBytes -= frames[f].size;
+    unlink(unloggedList, &Frame::unloggedPrev, &Frame::unloggedNext, f);
+  }
+  enqueue(FREE, f);
+}
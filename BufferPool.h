@@ -0,0 +1,291 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstddef>
+#include <vector>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * The process-wide pool of page frames shared by every PageFile.
+ * A page has to be pinned while its frame is in use; a pinned frame is
+ * never evicted. When a page is unpinned, the caller tells whether it
+ * modified the frame. Dirty frames stay in the pool until they are
+ * flushed or evicted; an evicted dirty page is written back together
+ * with the dirty pages next to it, so that the writes of a load reach
+ * the disk in long runs rather than page by page.
+ *
+ * A page of a logged file that was modified after the last commit of the
+ * WriteAheadLog is "unlogged": its new content exists only in the pool,
+ * so it must not reach the file before it is logged. Unlogged frames are
+ * never evicted; the modifications between two commits therefore have to
+ * fit in the pool. A frame that is dirty but logged remembers the LSN of
+ * its log record, so that the checkpointer knows how much of the log is
+ * still needed to recover the pages that are not written back. The
+ * unlogged frames and the frames with an LSN are kept in two lists, the
+ * latter in the order of the LSNs, so that commits, checkpoints and
+ * flushes only visit the dirty frames.
+ *
+ * Cached pages are found through a hash table on (fd, pid), and frames
+ * are replaced with the 2Q policy: a page read for the first time enters
+ * the FIFO queue A1in, and only a page that is requested again after it
+ * was pushed out of A1in (i.e., while it is remembered in the ghost
+ * queue A1out) is admitted to the LRU queue Am. A table scan therefore
+ * only cycles through A1in and leaves the hot index pages in Am alone.
+ *
+ * Files may use different page sizes, so the memory of a frame is
+ * allocated for the size of the page it holds, and the pool is bounded
+ * by the total bytes of its frames rather than by a number of frames.
+ * A frame whose memory does not fit the new page gives its memory back,
+ * and further pages are evicted until the new page fits in the budget.
+ *
+ * All functions of the pool are thread-safe. If several threads pin a page
+ * that is not cached, only one of them gets the frame with
+ * (frame->valid == false) and loads it; the others wait until the page
+ * is loaded. Dirty pages are written back without holding the lock of
+ * the pool, so that readers of other pages are not held up by the disk.
+ * A frame being written back stays pinned, and setUnlogged() waits until
+ * the write is done, so the page does not change while it is written.
+ */
+class BufferPool {
+ public:
+
+  static const size_t DEFAULT_POOL_SIZE = 64 * 1024 * 1024;  // 64MB
+
+  // the alignment of the frame memory (or the page size if smaller).
+  // frames are read and written with O_DIRECT in 'd' mode,
+  // which needs buffers aligned to the disk blocks
+  static const size_t FRAME_ALIGNMENT = 4096;
+
+  /**
+   * a frame of the pool that holds one page of a file
+   */
+  struct Frame {
+    int    fd;              // file id of the cached page
+    PageId pid;             // page id of the cached page
+    int    pinCount;        // # users of the frame. pinned frames stay
+    bool   valid;           // true if the frame holds the page content
+    bool   loading;         // true while a thread is loading the page
+    bool   dirty;           // true if the frame differs from the disk page
+    bool   unlogged;        // true if the changes of the frame are not logged yet
+    bool   writing;         // true while the page is written back without the lock
+    long long recLsn;       // the LSN of the last logged image of the page if
+                            // it is not written back yet (-1 otherwise)
+    int    logPrev, logNext;          // neighbors in the list of frames by recLsn
+    int    unloggedPrev, unloggedNext;  // neighbors in the list of unlogged frames
+    int    size;            // # bytes of data (0 if no memory is allocated)
+    char*  data;            // the page content
+
+    int    queue;           // the queue the frame belongs to (FREE, EMPTY, A1IN or AM)
+    int    prev, next;      // neighbors in the queue (-1 at the ends)
+    int    hashNext;        // next frame in the same hash bucket (-1 at the end)
+  };
+
+  /**
+   * set the size of the pool. should be called at startup before any
+   * file is opened; the frames of the previous pool are written back
+   * and released. the pool holds at least a few pages of the largest
+   * page size.
+   * @param bytes[IN] the memory budget of the pool in bytes
+   * @return error code. 0 if no error
+   */
+  static RC init(size_t bytes);
+
+  /**
+   * @return the number of frame descriptors in the pool,
+   *         i.e., the max # pages of the smallest size it can hold
+   */
+  static int getFrameCount() { return frameCount; }
+
+  /**
+   * pin the page (fd, pid) in the pool. If the page is not cached,
+   * a frame of size bytes is allocated for it with (frame->valid == false)
+   * and the caller is responsible for loading the page content into
+   * frame->data and calling validate().
+   * @param fd[IN] the file the page belongs to
+   * @param pid[IN] the page to pin
+   * @param size[IN] the page size of the file
+   * @param frame[OUT] the frame holding the page
+   * @return error code. 0 if no error
+   */
+  static RC pin(int fd, PageId pid, int size, Frame*& frame);
+
+  /**
+   * pin a frame that is already pinned by the caller once more.
+   * @param frame[IN] the frame returned by pin()
+   */
+  static void pin(Frame* frame);
+
+  /**
+   * mark the content of the frame loaded by the caller of pin() as valid
+   * and wake up the threads waiting for the page.
+   * @param frame[IN] the frame returned by pin()
+   */
+  static void validate(Frame* frame);
+
+  /**
+   * release a pin on the frame. An unpinned frame that is still invalid
+   * (i.e., its content was never loaded) is returned to the free frames.
+   * @param frame[IN] the frame returned by pin()
+   * @param dirty[IN] true if the caller modified the frame content
+   */
+  static void unpin(Frame* frame, bool dirty);
+
+  /**
+   * mark the pinned frame as modified by changes that are not in the
+   * write-ahead log yet. the frame is not evicted until it is logged.
+   * must be called before the frame is modified; waits while the page
+   * is being written back.
+   * @param frame[IN] the frame returned by pin()
+   */
+  static void setUnlogged(Frame* frame);
+
+  /**
+   * pin all unlogged frames and mark them as logged. the caller logs the
+   * content of the frames and unpins them afterwards.
+   * @param list[OUT] the unlogged frames
+   */
+  static void takeUnlogged(std::vector<Frame*>& list);
+
+  /**
+   * remember the LSN of the log record holding the image of the frame
+   * logged by the caller of takeUnlogged(). the LSNs have to be set in
+   * increasing order, as the records are appended to the log.
+   * @param frame[IN] the frame returned by takeUnlogged()
+   * @param lsn[IN] the LSN of the log record
+   */
+  static void setRecLsn(Frame* frame, long long lsn);
+
+  /**
+   * @return the smallest LSN of the logged images that are not written
+   *         back yet, or -1 if all logged images are written back
+   */
+  static long long getMinRecLsn();
+
+  /**
+   * write back the unpinned dirty frames whose changes are logged, in
+   * runs of adjacent pages. the files of the frames must stay open until
+   * this function returns.
+   * @return error code. 0 if no error
+   */
+  static RC writeBackLogged();
+
+  /**
+   * @return the total # bytes of the unlogged frames
+   */
+  static size_t getUnloggedBytes();
+
+  /**
+   * @return the memory budget of the pool in bytes
+   */
+  static size_t getBudget() { return budget; }
+
+  /**
+   * write back the dirty frame to its file.
+   * @param frame[IN] the pinned frame to write back
+   * @return error code. 0 if no error
+   */
+  static RC flush(Frame* frame);
+
+  /**
+   * write back all dirty frames of the file, including the pages that
+   * other threads are writing back when it is called.
+   * @param fd[IN] the file to flush
+   * @return error code. 0 if no error
+   */
+  static RC flushFile(int fd);
+
+  /**
+   * drop all frames of the file from the pool without writing them back.
+   * pages that are still being loaded are waited for first.
+   * @param fd[IN] the file to evict
+   */
+  static void evictFile(int fd);
+
+ private:
+  // free frames keep their memory for the next page,
+  // while the descriptors in EMPTY have no memory
+  enum { FREE, EMPTY, A1IN, AM, QUEUE_COUNT };
+
+  /**
+   * a queue of frames linked through Frame::prev and Frame::next.
+   * frames are added at the tail and evicted from the head.
+   */
+  struct Queue {
+    int    head;
+    int    tail;
+    int    count;
+    size_t bytes;           // # bytes of frame memory in the queue
+  };
+
+  /**
+   * a list of frames linked through a pair of neighbor fields of Frame
+   */
+  struct List {
+    int    head;
+    int    tail;
+  };
+
+  /**
+   * a page of a file, to find its frame again after the lock was released
+   */
+  struct Page {
+    int    fd;
+    PageId pid;
+    bool operator< (const Page& p) const { return fd != p.fd ? fd < p.fd : pid < p.pid; }
+  };
+
+  /**
+   * an entry of the ghost queue A1out remembering a page evicted from A1in
+   */
+  struct Ghost {
+    int    fd;              // file id of the page (-1 if the entry is unused)
+    PageId pid;             // page id of the page
+    int    hashNext;        // next ghost in the same hash bucket (-1 at the end)
+  };
+
+  static int    frameCount;   // # frame descriptors in the pool
+  static Frame* frames;       // the frame descriptors
+  static size_t budget;       // the max # bytes of frame memory
+  static size_t usedBytes;    // # bytes of frame memory allocated
+  static size_t unloggedBytes;  // # bytes of the unlogged frames
+  static Queue  queues[QUEUE_COUNT];
+  static List   loggedList;   // the frames with a recLsn by increasing recLsn
+  static List   unloggedList; // the unlogged frames
+
+  static int*   frameHash;    // hash buckets of cached pages
+  static int    hashMask;     // (# hash buckets - 1)
+
+  static int    ghostCount;   // capacity of A1out
+  static Ghost* ghosts;       // A1out as a ring buffer
+  static int    ghostTail;    // the ring slot the next ghost goes to
+  static int*   ghostHash;    // hash buckets of A1out (same # buckets as frameHash)
+
+  static pthread_mutex_t lock;      // protects all the data of the pool
+  static pthread_cond_t  loadDone;  // signaled when a page load ends
+  static pthread_cond_t  writeDone; // signaled when a write-back ends
+
+  static RC   allocate(size_t bytes);
+  static int  hash(int fd, PageId pid);
+  static int  lookupFrame(int fd, PageId pid);
+  static void unhashFrame(int f);
+  static bool removeGhost(int fd, PageId pid);
+  static void addGhost(int fd, PageId pid);
+  static void enqueue(int q, int f);
+  static void dequeue(int f);
+  static void link(List& list, int Frame::* prev, int Frame::* next, int f);
+  static void unlink(List& list, int Frame::* prev, int Frame::* next, int f);
+  static void clearRecLsn(int f);
+  static int  findVictim(int q);
+  static int  evict();
+  static RC   reserve(int f, int size);
+  static void freeMemory(int f);
+  static void release(int f);
+  static RC   writeBack(int f);
+  static RC   writeBackCluster(int f);
+  static RC   writeBackRun(int* f, int count);
+  static RC   writeBackPages(const std::vector<Page>& pages, bool all);
+};
+
+#endif // BUFFERPOOL_H
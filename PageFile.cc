@@ -1,39 +1,133 @@
 
 #include "Bruinbase.h"
 #include "PageFile.h"
+#include "AsyncIO.h"
+#include "BufferPool.h"
+#include "PageHandle.h"
+#include "WriteAheadLog.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
 #include <cstring>
 #include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 using std::string;
 
+// the header in the first disk page of every file
+struct FileHeader {
+  char   magic[12];   // FILE_MAGIC
+  int    version;     // the format version of the file
+  int    pageSize;    // the size of the pages of the file
+  PageId freeHead;    // the first trunk page of the free page list (-1 if none)
+};
+
+static const char FILE_MAGIC[12] = "BRUINBASE";
+
+// a trunk page of the free page list is (next trunk, # pages, pages...)
+struct FreeTrunk {
+  PageId next;        // the next trunk page (-1 at the end)
+  int    count;       // # free pages listed in this trunk
+  PageId pids[1];     // the free pages
+};
+
+// the header is read in a block that is large and aligned enough for O_DIRECT
+static const int HEADER_BLOCK_SIZE = 4096;
+
+// get the alignment O_DIRECT needs for the file offsets and buffers of the
+// file fd: from statx() if the kernel reports it, else the logical block
+// size of a device or the block size of the file system, which is a
+// multiple of it. 0 if the file cannot be read with O_DIRECT
+static int directAlignment(int fd)
+{
+  struct stat    st;
+  struct statvfs vfs;
+  int            size;
+
+#ifdef STATX_DIOALIGN
+  struct statx stx;
+  if (::statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN)) {
+    return std::max(stx.stx_dio_offset_align, stx.stx_dio_mem_align);
+  }
+#endif
+  if (::fstat(fd, &st) == 0 && S_ISBLK(st.st_mode) && ::ioctl(fd, BLKSSZGET, &size) == 0) return size;
+  if (::fstatvfs(fd, &vfs) == 0) return vfs.f_bsize;
+
+  return 0;
+}
+
+// read the file fd through the kernel page cache from now on
+static RC clearDirect(int fd)
+{
+  int flags = ::fcntl(fd, F_GETFL);
+
+  if (flags < 0 || ::fcntl(fd, F_SETFL, flags & ~O_DIRECT) < 0) return RC_FILE_OPEN_FAILED;
+  return 0;
+}
+
+// the offset of the page pid in a file. the header fills the first page
+static off_t pageOffset(PageId pid, int pageSize)
+{
+  return (off_t) (pid + 1) * pageSize;
+}
+
 int PageFile::readCount = 0;
 int PageFile::writeCount = 0;
-int PageFile::cacheClock = 1;
-struct PageFile::cacheStruct PageFile::readCache[PageFile::CACHE_COUNT];
+pthread_mutex_t PageFile::mapLock = PTHREAD_MUTEX_INITIALIZER;
 
 PageFile::PageFile() 
 { 
   fd = -1; 
   epid = 0; 
+  pageSize = DEFAULT_PAGE_SIZE;
+  version = FORMAT_VERSION;
+  writable = false;
+  logged = false;
+  scan = false;
+  mapped = false;
+  mapAddr = NULL;
+  mapSize = 0;
 }
 
 PageFile::PageFile(const string& filename, char mode)
 {
   fd = -1;
   epid = 0;
+  pageSize = DEFAULT_PAGE_SIZE;
+  version = FORMAT_VERSION;
+  writable = false;
+  logged = false;
+  scan = false;
+  mapped = false;
+  mapAddr = NULL;
+  mapSize = 0;
   open(filename.c_str(), mode);
 }
 
-RC PageFile::open(const string& filename, char mode)
+PageFile::~PageFile()
 {
-  RC   rc;
-  int  oflag;
+  // do not lose the modified pages of a file that was left open
+  if (fd >= 0) close();
+}
+
+RC PageFile::open(const string& filename, char mode, int pageSize)
+{
+  RC     rc;
+  int    oflag;
+  PageId freeHead;
   struct stat statbuf;
 
   if (fd > 0) return RC_FILE_OPEN_FAILED;
 
+  // bring the files up to date with the log of a previous run first
+  if ((rc = WriteAheadLog::recover()) < 0) return rc;
+
   // set the unix file flag depending on the file mode
   switch (mode) {
   case 'r':
@@ -44,42 +138,147 @@ RC PageFile::open(const string& filename, char mode)
   case 'W':
     oflag = (O_RDWR|O_CREAT);
     break;
+  case 'm':
+  case 'M':
+    oflag = O_RDONLY;
+    break;
+  case 'd':
+  case 'D':
+    oflag = (O_RDONLY|O_DIRECT);
+    break;
+  case 's':
+  case 'S':
+    oflag = O_RDONLY;
+    break;
   default:
     return RC_INVALID_FILE_MODE;
   }
 
-  // open the file
+  // open the file. fall back to buffered reads
+  // if the file system does not support O_DIRECT
   fd = ::open(filename.c_str(), oflag, 0644);
+  if (fd < 0 && errno == EINVAL && (oflag & O_DIRECT)) {
+    fd = ::open(filename.c_str(), oflag & ~O_DIRECT, 0644);
+  }
   if (fd < 0) { fd = -1; return RC_FILE_OPEN_FAILED; }
 
+  // the header block has to be aligned for O_DIRECT, too
+  int alignment = (oflag & O_DIRECT) ? directAlignment(fd) : 0;
+  if ((oflag & O_DIRECT) && (alignment <= 0 || HEADER_BLOCK_SIZE % alignment != 0)) {
+    if ((rc = clearDirect(fd)) < 0) { ::close(fd); fd = -1; return rc; }
+    oflag &= ~O_DIRECT;
+  }
+
   // get the size of the file to set the end pid
   rc = ::fstat(fd, &statbuf);
   if (rc < 0) { ::close(fd); fd = -1; return RC_FILE_OPEN_FAILED; }
-  epid = statbuf.st_size / PAGE_SIZE;
+
+  // get the page size of the file from its header
+  writable = (oflag & O_RDWR) != 0;
+  if ((rc = readHeader(statbuf.st_size, pageSize, freeHead)) < 0) {
+    ::close(fd);
+    fd = -1;
+    return rc;
+  }
+  epid = statbuf.st_size / this->pageSize - 1;
+  if (epid < 0) epid = 0;
+
+  // pages are read at multiples of the page size, so O_DIRECT fails for
+  // pages smaller than the alignment, e.g., 1KB pages on a disk with 4KB
+  // blocks. such a file is read through the kernel page cache instead
+  if ((oflag & O_DIRECT) && this->pageSize % alignment != 0 && (rc = clearDirect(fd)) < 0) {
+    ::close(fd);
+    fd = -1;
+    return rc;
+  }
+
+  // the free pages of a writable file are kept in memory until it is
+  // closed. the list on disk is dropped, so that a crash before close()
+  // only leaks the free pages instead of handing them out twice
+  if (writable && freeHead >= 0) {
+    if ((rc = loadFreeList(freeHead)) < 0 || (rc = writeHeader(-1)) < 0) {
+      freePages.clear();
+      BufferPool::evictFile(fd);
+      ::close(fd);
+      fd = -1;
+      return rc;
+    }
+  }
+
+  // the pages written to the file are logged before they reach it
+  if (writable && (rc = WriteAheadLog::addFile(fd, filename)) < 0) {
+    freePages.clear();
+    BufferPool::evictFile(fd);
+    ::close(fd);
+    fd = -1;
+    return rc;
+  }
+  logged = writable;
+
+  // a scan reads ahead from the first page on
+  scan = (mode == 's' || mode == 'S');
+  lastRead = -1;
+  sequential = scan ? SEQUENTIAL_THRESHOLD : 0;
+  readaheadEnd = 0;
+  if (scan) ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  // map the file in memory-mapped mode
+  if (mode == 'm' || mode == 'M') {
+    mapped = true;
+    if ((rc = remap()) < 0) { ::close(fd); fd = -1; mapped = false; return rc; }
+  }
 
   return 0;
 }
 
 RC PageFile::close()
 {
+  RC rc;
+
   if (fd <= 0) return RC_FILE_CLOSE_FAILED;
 
-  // close the file
-  if (::close(fd) < 0) return RC_FILE_CLOSE_FAILED;
-
-  // evict all cached pages for this file
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].lastAccessed != 0) {
-       readCache[i].fd = 0;
-       readCache[i].pid = 0;
-       readCache[i].lastAccessed = 0;
+  // unmap the file in memory-mapped mode
+  if (mapped) {
+    for (unsigned i = 0; i < oldMaps.size(); i++) {
+      ::munmap(oldMaps[i].first, oldMaps[i].second);
     }
+    oldMaps.clear();
+    if (mapAddr != NULL) ::munmap(mapAddr, mapSize);
+    mapped = false;
+    mapAddr = NULL;
+    mapSize = 0;
   }
 
+  // store the free pages in the file. free pages at the end of the file
+  // are cut off instead
+  PageId oldEpid = epid;
+  rc = (writable) ? saveFreeList() : 0;
+
+  // write back the modified pages and evict all cached pages for this file
+  RC rc2 = BufferPool::flushFile(fd);
+  if (rc == 0) rc = rc2;
+  BufferPool::evictFile(fd);
+
+  // sync all writes of the file at once. the file no longer needs the log
+  // then, and the checkpointer is done with it before it is truncated.
+  // if the pages could not be synced, the log keeps them for recovery
+  if (writable && ::fdatasync(fd) < 0 && rc == 0) rc = RC_FILE_WRITE_FAILED;
+  if (logged && rc == 0) rc = WriteAheadLog::removeFile(fd);
+
+  if (epid < oldEpid && ::ftruncate(fd, pageOffset(epid, pageSize)) < 0 && rc == 0) {
+    rc = RC_FILE_WRITE_FAILED;
+  }
+
+  // close the file
+  if (::close(fd) < 0 && rc == 0) rc = RC_FILE_CLOSE_FAILED;
+
   // set the fd and epid to the initial state
   fd = -1; 
   epid = 0;
-  return 0;
+  writable = false;
+  logged = false;
+  freePages.clear();
+  return rc;
 }
 
 PageId PageFile::endPid() const 
@@ -87,86 +286,485 @@ PageId PageFile::endPid() const
   return epid;
 }
 
-RC PageFile::seek(PageId pid) const
+RC PageFile::writeBack(int fd, PageId pid, int pageSize, char* const* pages, int count)
 {
-  return (::lseek(fd, pid * PAGE_SIZE, SEEK_SET) < 0) ? RC_FILE_SEEK_FAILED : 0;
+  struct iovec iov[MAX_IO_RUN];
+  off_t        offset = pageOffset(pid, pageSize);
+  ssize_t      rc;
+
+  // write the pages with one system call at the location of the first page
+  if (count == 1) {
+    rc = ::pwrite(fd, pages[0], pageSize, offset);
+  } else {
+    for (int i = 0; i < count; i++) {
+      iov[i].iov_base = pages[i];
+      iov[i].iov_len = pageSize;
+    }
+    rc = ::pwritev(fd, iov, count, offset);
+  }
+  if (rc < 0) return RC_FILE_WRITE_FAILED;
+
+  // increase page write count
+  __sync_fetch_and_add(&writeCount, count);
+
+  return 0;
 }
 
 RC PageFile::write(PageId pid, const void* buffer)
 {
   RC rc;
-  if (pid < 0) return RC_INVALID_PID; 
+  BufferPool::Frame* frame;
 
-  // seek to the location of the page
-  if ((rc = seek(pid)) < 0) return rc;
-
-  // write the buffer to the disk page
-  if (::write(fd, buffer, PAGE_SIZE) < 0) return RC_FILE_WRITE_FAILED;
+  if (pid < 0) return RC_INVALID_PID; 
+  if (mapped) return RC_INVALID_FILE_MODE;
 
-  // if the page is in read cache, invalidate it
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid &&
-        readCache[i].lastAccessed != 0) {
-       readCache[i].fd = 0;
-       readCache[i].pid = 0;
-       readCache[i].lastAccessed = 0;
-       break;
-    }
-  }
+  // update the frame of the page in the buffer pool.
+  // the page is written back when it is evicted or flushed.
+  // a logged page is marked before it changes, so that the
+  // checkpointer does not copy it halfway
+  if ((rc = BufferPool::pin(fd, pid, pageSize, frame)) < 0) return rc;
+  if (logged) BufferPool::setUnlogged(frame);
+  memcpy(frame->data, buffer, pageSize);
+  BufferPool::validate(frame);
+  BufferPool::unpin(frame, true);
 
   // if the written pid >= end pid, update the end pid
   if (pid >= epid) epid = pid + 1;
 
-  // increase page write count
-  writeCount++;
+  return 0;
+}
+
+RC PageFile::flush()
+{
+  RC rc;
+
+  if (fd < 0) return RC_FILE_WRITE_FAILED;
+  if (!writable) return 0;
+
+  if (logged && (rc = WriteAheadLog::commit()) < 0) return rc;
+  if ((rc = BufferPool::flushFile(fd)) < 0) return rc;
+  if (::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
 
   return 0;
 }
 
 RC PageFile::read(PageId pid, void* buffer) const
+{
+  return readPages(pid, 1, buffer);
+}
+
+RC PageFile::readPage(PageId pid, PageHandle& handle) const
 {
   RC rc;
+  const char* page;
+  BufferPool::Frame* frame;
+
+  // in memory-mapped mode, the handle points into the mapping
+  if (mapped) {
+    if ((rc = readMapped(pid, page)) < 0) return rc;
+    handle.release();
+    handle.page = page;
+    return 0;
+  }
 
   if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
+  readAhead(pid, 1);
+
+  // pin the frame of the page in the buffer pool
+  if ((rc = BufferPool::pin(fd, pid, pageSize, frame)) < 0) return rc;
+
+  // if the page is not in the pool yet, read it from the disk.
+  // a short read leaves the frame without the page content
+  if (!frame->valid) {
+    if (::pread(fd, frame->data, pageSize, pageOffset(pid, pageSize)) != pageSize) {
+      BufferPool::unpin(frame, false);
+      return RC_FILE_READ_FAILED;
+    }
+    BufferPool::validate(frame);
+
+    // increase the page read count
+    __sync_fetch_and_add(&readCount, 1);
+  }
+
+  // the handle takes over the pin of the frame
+  handle.release();
+  handle.frame = frame;
+  handle.page = frame->data;
+
+  return 0;
+}
+
+RC PageFile::readPages(PageId pid, int count, void* buffer) const
+{
+  RC   rc = 0;
+  int  pinned, i, j, n;
+  BufferPool::Frame* frame[MAX_IO_RUN];
+  struct iovec       iov[MAX_IO_RUN];
+
+  if (pid < 0 || count < 0) return RC_INVALID_PID; 
 
-  //
-  // if the page is in cache, read it from there
-  //
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid && 
-        readCache[i].lastAccessed != 0) {
-       memcpy(buffer, readCache[i].buffer, PAGE_SIZE);
-       readCache[i].lastAccessed = ++cacheClock;
-       return 0;
+  // in memory-mapped mode, copy the pages straight from the mapping.
+  // looking up the last page first grows the mapping if necessary.
+  if (mapped) {
+    const char* page;
+    if (count == 0) return 0;
+    if ((rc = readMapped(pid + count - 1, page)) < 0) return rc;
+    memcpy(buffer, page - (size_t) (count - 1) * pageSize, (size_t) count * pageSize);
+    __sync_fetch_and_add(&readCount, count - 1);
+    return 0;
+  }
+
+  if (pid + count > epid) return RC_INVALID_PID; 
+  if (count > 0) readAhead(pid, count);
+
+  for (; count > 0; pid += n, count -= n) {
+    n = (count < MAX_IO_RUN) ? count : MAX_IO_RUN;
+
+    // pin the frames of the pages in the buffer pool
+    for (pinned = 0; pinned < n; pinned++) {
+      if ((rc = BufferPool::pin(fd, pid + pinned, pageSize, frame[pinned])) < 0) break;
     }
+
+    // read each run of pages that are not in the pool yet from the disk
+    // with one system call, straight into their frames. a run that ends
+    // early, e.g., at the end of a truncated file, fails as a whole
+    for (i = 0; i < pinned && rc == 0; i = j) {
+      if (frame[i]->valid) { j = i + 1; continue; }
+
+      for (j = i; j < pinned && !frame[j]->valid; j++) {
+        iov[j - i].iov_base = frame[j]->data;
+        iov[j - i].iov_len = pageSize;
+      }
+      if (::preadv(fd, iov, j - i, pageOffset(pid + i, pageSize)) != (ssize_t) (j - i) * pageSize) {
+        rc = RC_FILE_READ_FAILED;
+        break;
+      }
+      for (int k = i; k < j; k++) BufferPool::validate(frame[k]);
+
+      // increase the page read count
+      __sync_fetch_and_add(&readCount, j - i);
+    }
+
+    // copy the pages to the buffer and release the frames
+    for (i = 0; i < pinned; i++) {
+      if (rc == 0) memcpy((char*) buffer + i * pageSize, frame[i]->data, pageSize);
+      BufferPool::unpin(frame[i], false);
+    }
+    if (rc < 0) return rc;
+
+    buffer = (char*) buffer + n * pageSize;
   }
 
-  // seek to the page
-  if ((rc = seek(pid)) < 0) return rc;
-  
-  // find the cache slot to evict
-  int toEvict = 0; 
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].lastAccessed == 0) {
-      toEvict = i;
-      break;
+  return 0;
+}
+
+RC PageFile::prefetch(const PageId* pids, int count) const
+{
+  RC rc;
+  BufferPool::Frame* frame;
+
+  // read the pages in the order of the file, and each page only once,
+  // since a second pin() of a page queued here would wait for the
+  // read that has not been submitted yet
+  std::vector<PageId> sorted(pids, pids + count);
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+  pids = sorted.empty() ? NULL : &sorted[0];
+  count = sorted.size();
+
+  for (int i = 0; i < count; i++) {
+    if (pids[i] < 0 || pids[i] >= epid) continue;
+    off_t offset = pageOffset(pids[i], pageSize);
+
+    // in memory-mapped mode, let the kernel fault the pages in
+    if (mapped) {
+      off_t start = offset & ~(off_t) (getpagesize() - 1);
+      ::madvise(mapAddr + start, offset + pageSize - start, MADV_WILLNEED);
+      continue;
+    }
+
+    // if the pool is full of pinned pages, stop prefetching
+    if (BufferPool::pin(fd, pids[i], pageSize, frame) < 0) break;
+    if (frame->valid) {
+      BufferPool::unpin(frame, false);
+      continue;
     }
-    if (readCache[i].lastAccessed < readCache[toEvict].lastAccessed) {
-      toEvict = i;
+
+    // the read keeps the frame pinned until prefetchDone() is called.
+    // if the read cannot be queued, advise the kernel to read ahead.
+    if (!AsyncIO::available() ||
+        AsyncIO::queueRead(fd, frame->data, pageSize, offset, prefetchDone, frame) < 0) {
+      BufferPool::unpin(frame, false);
+      ::posix_fadvise(fd, offset, pageSize, POSIX_FADV_WILLNEED);
     }
   }
-  readCache[toEvict].fd = fd;
-  readCache[toEvict].pid = pid;
-  readCache[toEvict].lastAccessed = ++cacheClock;
- 
-  // read the page to cache first and copy it to the buffer
-  if (::read(fd, readCache[toEvict].buffer, PAGE_SIZE) < 0) {
-    return RC_FILE_READ_FAILED;
+
+  // start all queued reads at once. the reads that cannot be started
+  // complete as failed through prefetchDone(), which releases their frames
+  if (!mapped && AsyncIO::available() && (rc = AsyncIO::submit()) < 0) return rc;
+
+  return 0;
+}
+
+void PageFile::prefetchDone(void* frame, int result)
+{
+  BufferPool::Frame* f = (BufferPool::Frame*) frame;
+
+  // the waiting readers load the page themselves if the read failed
+  // or ended before the end of the page
+  if (result == f->size) {
+    BufferPool::validate(f);
+
+    // increase the page read count
+    __sync_fetch_and_add(&readCount, 1);
   }
-  memcpy(buffer, readCache[toEvict].buffer, PAGE_SIZE);
+  BufferPool::unpin(f, false);
+}
 
-  // increase the page read count
-  readCount++;
+RC PageFile::readBatch(const PageId* pids, int count, void* const* buffers) const
+{
+  RC rc;
+
+  // start reading all pages first, then wait for them one by one
+  if ((rc = prefetch(pids, count)) < 0) return rc;
+  for (int i = 0; i < count; i++) {
+    if ((rc = read(pids[i], buffers[i])) < 0) return rc;
+  }
 
   return 0;
 }
+
+RC PageFile::readMapped(PageId pid, const char*& page) const
+{
+  RC rc;
+
+  if (!mapped) return RC_INVALID_FILE_MODE;
+  if (pid < 0) return RC_INVALID_PID;
+
+  // the file may have grown since it was mapped
+  if (pid >= __atomic_load_n(&epid, __ATOMIC_ACQUIRE)) {
+    if ((rc = remap()) < 0) return rc;
+    if (pid >= epid) return RC_INVALID_PID;
+  }
+  page = __atomic_load_n(&mapAddr, __ATOMIC_ACQUIRE) + pageOffset(pid, pageSize);
+
+  // the page faults are invisible to us, so every page access is counted
+  __sync_fetch_and_add(&readCount, 1);
+
+  return 0;
+}
+
+RC PageFile::remap() const
+{
+  struct stat statbuf;
+  size_t      length;
+  void*       addr;
+
+  pthread_mutex_lock(&mapLock);
+
+  if (::fstat(fd, &statbuf) < 0) {
+    pthread_mutex_unlock(&mapLock);
+    return RC_FILE_MAP_FAILED;
+  }
+
+  // if the file outgrew the mapping, map it again with at least twice
+  // the length. the mapping may extend beyond the end of the file so
+  // that the file can grow a while before it has to be mapped again.
+  if ((size_t) statbuf.st_size > mapSize) {
+    length = (mapSize > 0) ? mapSize * 2 : MIN_MAP_SIZE;
+    while (length < (size_t) statbuf.st_size) length *= 2;
+
+    addr = ::mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      pthread_mutex_unlock(&mapLock);
+      return RC_FILE_MAP_FAILED;
+    }
+
+    if (mapAddr != NULL) oldMaps.push_back(std::make_pair(mapAddr, mapSize));
+    mapSize = length;
+    __atomic_store_n(&mapAddr, (char*) addr, __ATOMIC_RELEASE);
+  }
+  __atomic_store_n(&epid, (PageId) (statbuf.st_size / pageSize - 1), __ATOMIC_RELEASE);
+
+  pthread_mutex_unlock(&mapLock);
+  return 0;
+}
+
+RC PageFile::readHeader(off_t size, int newPageSize, PageId& freeHead)
+{
+  RC   rc;
+  char header[HEADER_BLOCK_SIZE] __attribute__((aligned(HEADER_BLOCK_SIZE)));
+  FileHeader* h = (FileHeader*) header;
+
+  // a new file gets a header page with the requested page size
+  if (size == 0 && writable) {
+    if (newPageSize < MIN_PAGE_SIZE || newPageSize > MAX_PAGE_SIZE ||
+        (newPageSize & (newPageSize - 1)) != 0) return RC_INVALID_PAGE_SIZE;
+
+    std::vector<char> page(newPageSize, 0);
+    if (::pwrite(fd, &page[0], newPageSize, 0) != newPageSize) return RC_FILE_WRITE_FAILED;
+
+    // the header is synced right away, since recovering the pages
+    // of the file from the log depends on it
+    pageSize = newPageSize;
+    version = FORMAT_VERSION;
+    freeHead = -1;
+    if ((rc = writeHeader(-1)) < 0) return rc;
+    if (::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+    return 0;
+  }
+
+  if (::pread(fd, header, HEADER_BLOCK_SIZE, 0) < (ssize_t) sizeof(FileHeader)) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+  if (memcmp(h->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) return RC_INVALID_FILE_FORMAT;
+  if (h->version < 1 || h->version > FORMAT_VERSION) return RC_INVALID_FILE_FORMAT;
+  if (h->pageSize < MIN_PAGE_SIZE || h->pageSize > MAX_PAGE_SIZE ||
+      (h->pageSize & (h->pageSize - 1)) != 0) return RC_INVALID_FILE_FORMAT;
+
+  // files of version 1 have no free page list. since the free page list
+  // does not change the pages, they become version 2 when it is saved.
+  // later versions are kept, as they change the content of the pages
+  pageSize = h->pageSize;
+  freeHead = (h->version >= 2) ? h->freeHead : -1;
+  version = (h->version >= 2) ? h->version : 2;
+  return 0;
+}
+
+RC PageFile::writeHeader(PageId freeHead)
+{
+  FileHeader h;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+  h.version = version;
+  h.pageSize = pageSize;
+  h.freeHead = freeHead;
+  if (::pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) return RC_FILE_WRITE_FAILED;
+
+  return 0;
+}
+
+RC PageFile::allocatePage(PageId hint, PageId& pid)
+{
+  if (!writable) return RC_INVALID_FILE_MODE;
+
+  // if there is no free page, the file grows by a page
+  if (freePages.empty()) {
+    pid = epid++;
+    return 0;
+  }
+
+  // take the free page closest to the hint
+  std::set<PageId>::iterator it = freePages.lower_bound(hint);
+  if (it == freePages.end()) {
+    --it;
+  } else if (it != freePages.begin()) {
+    std::set<PageId>::iterator before = it;
+    if (hint - *--before < *it - hint) it = before;
+  }
+  pid = *it;
+  freePages.erase(it);
+
+  return 0;
+}
+
+RC PageFile::freePage(PageId pid)
+{
+  if (!writable) return RC_INVALID_FILE_MODE;
+  if (pid < 0 || pid >= epid) return RC_INVALID_PID;
+  if (!freePages.insert(pid).second) return RC_INVALID_PID;
+
+  return 0;
+}
+
+RC PageFile::loadFreeList(PageId head)
+{
+  RC rc;
+  std::vector<char> page(pageSize);
+  FreeTrunk* trunk = (FreeTrunk*) &page[0];
+  int capacity = (pageSize - offsetof(FreeTrunk, pids)) / sizeof(PageId);
+
+  // the trunk pages are free as well once their list is in memory
+  for (PageId pid = head; pid >= 0; pid = trunk->next) {
+    if (pid >= epid || !freePages.insert(pid).second) return RC_INVALID_FILE_FORMAT;
+    if ((rc = read(pid, &page[0])) < 0) return rc;
+    if (trunk->count < 0 || trunk->count > capacity) return RC_INVALID_FILE_FORMAT;
+    for (int i = 0; i < trunk->count; i++) {
+      if (trunk->pids[i] < 0 || trunk->pids[i] >= epid) return RC_INVALID_FILE_FORMAT;
+      freePages.insert(trunk->pids[i]);
+    }
+  }
+
+  return 0;
+}
+
+RC PageFile::saveFreeList()
+{
+  RC     rc;
+  PageId head = -1;
+  std::vector<char> page(pageSize, 0);
+  FreeTrunk* trunk = (FreeTrunk*) &page[0];
+  int capacity = (pageSize - offsetof(FreeTrunk, pids)) / sizeof(PageId);
+
+  // the free pages at the end of the file are cut off by close()
+  while (!freePages.empty() && *freePages.rbegin() == epid - 1) {
+    freePages.erase(--freePages.end());
+    epid--;
+  }
+
+  // the free pages are listed in trunk pages taken from the free pages
+  // themselves. each trunk links to the one written before it
+  while (!freePages.empty()) {
+    PageId pid = *freePages.begin();
+    freePages.erase(freePages.begin());
+
+    trunk->next = head;
+    for (trunk->count = 0; trunk->count < capacity && !freePages.empty(); trunk->count++) {
+      trunk->pids[trunk->count] = *freePages.begin();
+      freePages.erase(freePages.begin());
+    }
+    if ((rc = write(pid, &page[0])) < 0) return rc;
+    head = pid;
+  }
+
+  // the header is written in place, so the trunk pages
+  // have to be committed before it refers to them
+  if (logged && (rc = WriteAheadLog::commit()) < 0) return rc;
+  return writeHeader(head);
+}
+
+void PageFile::readAhead(PageId pid, int count) const
+{
+  PageId last = __atomic_load_n(&lastRead, __ATOMIC_RELAXED);
+  int    run = __atomic_load_n(&sequential, __ATOMIC_RELAXED);
+  PageId end = __atomic_load_n(&readaheadEnd, __ATOMIC_RELAXED);
+
+  // rereading the last page keeps the run, reading the next page extends
+  // it, and a jump starts over. a scan keeps reading ahead after a jump
+  if (pid == last + 1) {
+    run += count;
+  } else if (pid != last) {
+    run = scan ? SEQUENTIAL_THRESHOLD : 0;
+    end = 0;
+  }
+  __atomic_store_n(&lastRead, pid + count - 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&sequential, run, __ATOMIC_RELAXED);
+  __atomic_store_n(&readaheadEnd, end, __ATOMIC_RELAXED);
+  if (run < SEQUENTIAL_THRESHOLD) return;
+
+  // the next window is read once the reader has consumed half of
+  // the pages read ahead
+  PageId next = pid + count;
+  PageId window = (READAHEAD_SIZE / pageSize > 8) ? READAHEAD_SIZE / pageSize : 8;
+  if (end < next) end = next;
+  if (end - next > window / 2) return;
+
+  PageId to = (next + window < epid) ? next + window : epid;
+  if (to <= end) return;
+  __atomic_store_n(&readaheadEnd, to, __ATOMIC_RELAXED);
+
+  std::vector<PageId> pids;
+  for (PageId p = end; p < to; p++) pids.push_back(p);
+  prefetch(&pids[0], pids.size());
+}
@@ -3,36 +3,114 @@
 #ifndef PAGEFILE_H
 #define PAGEFILE_H
 
+#include <set>
 #include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/types.h>
 #include "Bruinbase.h"
 
-typedef int PageId;
+// page ids are 64-bit so that a file can grow beyond 2^31 pages
+typedef long long PageId;
+
+// the page size of new files can be set at compile time, e.g.,
+// -DBRUINBASE_PAGE_SIZE=4096. it must be a power of two between
+// PageFile::MIN_PAGE_SIZE and PageFile::MAX_PAGE_SIZE, and a multiple of
+// the logical block size of the disk for 'd' mode to bypass the page cache.
+#ifndef BRUINBASE_PAGE_SIZE
+#define BRUINBASE_PAGE_SIZE 1024
+#endif
+
+class PageHandle;
 
 /**
- * read/write a file in the unit of a page
+ * read/write a file in the unit of a page.
+ * the page size of a file is chosen when the file is created and is
+ * recorded in a header at the beginning of the file, together with the
+ * version of the file format.
+ *
+ * pages that are no longer used can be freed and are handed out again
+ * by allocatePage(), preferably close to a given page. the free pages
+ * are kept in memory while the file is open for writing and stored in
+ * a chain of free pages when it is closed; free pages at the end of the
+ * file are cut off. the header fills
+ * the first disk page, so page pid is stored at offset
+ * ((pid + 1) * page size) and pages stay aligned to their size.
+ * pages are accessed through the BufferPool with positional I/O, so
+ * several threads may read the same PageFile at the same time.
+ * writes to a file must not run concurrently with other accesses to it.
+ * written pages stay dirty in the BufferPool and reach the disk when
+ * they are evicted or when the file is flushed or closed, so they are
+ * not visible through another open of the same file before that.
+ * the pages of a file opened in 'w' mode are protected by the
+ * WriteAheadLog: they reach the file only after they are committed,
+ * and the committed pages are recovered when a file is opened after
+ * a crash.
+ *
+ * a file opened in 'm' mode is memory-mapped and read-only. its pages are
+ * read straight from the mapping, so the kernel page cache is the only
+ * cache of the file and the BufferPool is not used.
+ *
+ * a file opened in 'd' mode is read-only and bypasses the kernel page
+ * cache with O_DIRECT, so the BufferPool is the only cache of the file.
+ * if the file system does not support O_DIRECT, or the page size of the
+ * file is not a multiple of the block size O_DIRECT needs, the file is
+ * read through the page cache as in 'r' mode.
+ *
+ * when pages are read in order, the following pages are read ahead into
+ * the BufferPool with prefetch(). a file opened in 's' mode is read-only
+ * and expected to be scanned, so it is read ahead from the first read
+ * and the kernel is advised of the sequential access.
  */
 class PageFile {
  public:
 
-  static const int PAGE_SIZE = 1024;    // the size of a page is 1KB
+  static const int MIN_PAGE_SIZE = 1024;        // 1KB
+  static const int MAX_PAGE_SIZE = 64 * 1024;   // 64KB
+  static const int DEFAULT_PAGE_SIZE = BRUINBASE_PAGE_SIZE;  // 1KB by default
+
+  // the version of the file format of new files. version 1 has 64-bit
+  // page ids, version 2 adds the free page list to the header,
+  // version 3 stores records in slotted pages, version 4 stores long
+  // values in overflow pages, version 5 adds the PAX record layout,
+  // version 6 adds the record file header and deleted records,
+  // version 7 adds the stubs of records moved by updates, version 8
+  // adds the statistics of the file to the record file header, and
+  // version 9 stores the keys of a B+tree node apart from its entries
+  static const int FORMAT_VERSION = 9;
 
   PageFile();
   PageFile(const std::string& filename, char mode);
+  ~PageFile();
 
   /**
-   * open a file in read or write mode.
+   * open a file in read, write, memory-mapped read or direct read mode.
    * when opened in 'w' mode, if the file does not exist, it is created.
+   * if the file system does not support direct I/O, a file opened in
+   * 'd' mode is read through the kernel page cache as in 'r' mode.
    * @param filename[IN] the name of the file to open
-   * @param mode[IN] 'r' for read, 'w' for write
+   * @param mode[IN] 'r' for read, 'w' for write, 'm' for memory-mapped read,
+   *                 'd' for direct read, 's' for sequential scan
+   * @param pageSize[IN] the page size of the file if it is created.
+   *                     an existing file keeps the page size in its header
    * @return error code. 0 if no error
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, int pageSize = DEFAULT_PAGE_SIZE);
 
   /**
-   * close the file.
+   * close the file. the modified pages are written back
+   * and synced to the disk.
    * @return error code. 0 if no error
    */
   RC close();
+
+  /**
+   * commit the modified pages to the WriteAheadLog, write them back to
+   * the file in runs of adjacent pages and sync them to the disk with
+   * one fdatasync().
+   * @return error code. 0 if no error
+   */
+  RC flush();
   
   /**
    * read a disk page into memory buffer.
@@ -41,9 +119,68 @@ class PageFile {
    * @return error code. 0 if no error
    */
   RC read(PageId pid, void *buffer) const;
+
+  /**
+   * pin a disk page in the buffer pool and return a read-only view of it
+   * without copying the page. the page stays pinned until the handle is
+   * released, reassigned or destroyed.
+   * @param pid[IN] the page to read
+   * @param handle[OUT] the handle referring to the pinned page
+   * @return error code. 0 if no error
+   */
+  RC readPage(PageId pid, PageHandle& handle) const;
+
+  /**
+   * read count adjacent disk pages into memory buffer.
+   * the pages that are not in the buffer pool are read with one
+   * system call per run of missing pages.
+   * @param pid[IN] the first page to read
+   * @param count[IN] the number of pages to read
+   * @param buffer[OUT] pointer to memory buffer of (count * getPageSize()) bytes
+   * @return error code. 0 if no error
+   */
+  RC readPages(PageId pid, int count, void *buffer) const;
+
+  /**
+   * start reading disk pages into the buffer pool without waiting for
+   * them. the reads are submitted together through io_uring, and a later
+   * read() of a page waits until the page arrives. without io_uring, or
+   * for a file opened in 'm' mode, the kernel is advised to read the
+   * pages ahead instead. pages that are cached or out of range are skipped.
+   * @param pids[IN] the pages to read
+   * @param count[IN] the number of pages
+   * @return error code. 0 if no error
+   */
+  RC prefetch(const PageId* pids, int count) const;
+
+  /**
+   * read a batch of disk pages into memory buffers. all pages missing
+   * from the buffer pool are read at the same time.
+   * @param pids[IN] the pages to read
+   * @param count[IN] the number of pages
+   * @param buffers[OUT] pointers to the memory buffers of the pages
+   * @return error code. 0 if no error
+   */
+  RC readBatch(const PageId* pids, int count, void* const* buffers) const;
+
+  /**
+   * get a pointer to a page of a file opened in 'm' mode without
+   * copying the page. the pointer stays valid until the file is closed.
+   * if the file has grown since it was mapped, the mapping grows as well.
+   * @param pid[IN] the page to read
+   * @param page[OUT] pointer to the page in the mapping
+   * @return error code. 0 if no error
+   */
+  RC readMapped(PageId pid, const char*& page) const;
+
+  /**
+   * @return true if the file is opened in 'm' mode
+   */
+  bool isMapped() const { return mapped; }
   
   /**
-   * write the memory buffer to the disk page.
+   * write the memory buffer to the disk page. the page is updated in
+   * the buffer pool and written to the disk later.
    * if (pid >= endPid()), the file is expanded such that
    * endPid() becomes (pid + 1).
    * @param pid[IN] page to write to
@@ -59,6 +196,38 @@ class PageFile {
    */
   PageId endPid() const;
 
+  /**
+   * @return the size of the pages of the file in bytes
+   */
+  int getPageSize() const { return pageSize; }
+
+  /**
+   * @return the version of the format the file was created with
+   */
+  int getFormatVersion() const { return version; }
+
+  /**
+   * allocate a page for new content. the free page closest to hint is
+   * reused if there is one; otherwise the file grows by one page.
+   * the content of the page is undefined until it is written.
+   * @param hint[IN] the page the new page should be close to
+   * @param pid[OUT] the allocated page
+   * @return error code. 0 if no error
+   */
+  RC allocatePage(PageId hint, PageId& pid);
+
+  /**
+   * return a page that is no longer used to the free pages of the file.
+   * @param pid[IN] the page to free
+   * @return error code. 0 if no error
+   */
+  RC freePage(PageId pid);
+
+  /**
+   * @return the number of free pages of the file
+   */
+  PageId getFreePageCount() const { return freePages.size(); }
+
   /**
    * @return the total # of disk reads
    */
@@ -71,32 +240,113 @@ class PageFile {
 
  protected:
   /**
-   * move the file cursor to the beginning of a page.
+   * write count adjacent pages of the file whose descriptor is fd
+   * with one system call. the buffer pool calls this function to
+   * write back dirty frames.
+   * @param fd[IN] the file descriptor
+   * @param pid[IN] the first page to write to
+   * @param pageSize[IN] the page size of the file
+   * @param pages[IN] the content to write to each page
+   * @param count[IN] the number of pages to write
+   * @return error code. 0 if no error
+   */
+  static RC writeBack(int fd, PageId pid, int pageSize, char* const* pages, int count);
+  friend class BufferPool;
+  friend class WriteAheadLog;
+
+  /**
+   * the callback of an asynchronous page read started by prefetch().
+   * @param frame[IN] the frame the page was read into
+   * @param result[IN] # bytes read, or -errno if the read failed
+   */
+  static void prefetchDone(void* frame, int result);
+
+  /**
+   * map the whole file into memory after it has grown.
    * this is an internal function not exposed to public.
-   * @param pid[IN] page to seek to
    * @return error code. 0 if no error
    */
-  RC seek(PageId pid) const;
+  RC remap() const;
+
+  /**
+   * read the page size from the header of the file, or write the header
+   * if the file is empty and can be written.
+   * this is an internal function not exposed to public.
+   * @param size[IN] the size of the file in bytes
+   * @param newPageSize[IN] the page size of an empty file
+   * @param freeHead[OUT] the first trunk page of the free page list
+   * @return error code. 0 if no error
+   */
+  RC readHeader(off_t size, int newPageSize, PageId& freeHead);
+
+  /**
+   * write the header of the file.
+   * this is an internal function not exposed to public.
+   * @param freeHead[IN] the first trunk page of the free page list
+   * @return error code. 0 if no error
+   */
+  RC writeHeader(PageId freeHead);
+
+  /**
+   * read the free page list starting at the trunk page head into memory.
+   * this is an internal function not exposed to public.
+   * @param head[IN] the first trunk page
+   * @return error code. 0 if no error
+   */
+  RC loadFreeList(PageId head);
+
+  /**
+   * write the free pages in memory to the file and link them
+   * from the header. this is an internal function not exposed to public.
+   * @return error code. 0 if no error
+   */
+  RC saveFreeList();
+
+  /**
+   * track the order of page reads, and read the following pages ahead
+   * if the pages are read sequentially.
+   * this is an internal function not exposed to public.
+   * @param pid[IN] the first page read
+   * @param count[IN] the number of pages read
+   */
+  void readAhead(PageId pid, int count) const;
 
  private:
   int     fd;     // file descriptor of the associated unix file
-  PageId  epid;   // (last page id + 1) of the file
+  mutable PageId epid;   // (last page id + 1) of the file
+  int     pageSize;      // the size of the pages of the file
+  int     version;       // the format version of the file
+  bool    writable;      // true if the file is opened in 'w' mode
+  bool    logged;        // true if the writes go through the WriteAheadLog
+  std::set<PageId> freePages;  // the free pages of a writable file
+
+  //
+  // the following members implement the readahead. they are only hints,
+  // so concurrent readers update them without a lock
+  //
+  static const int SEQUENTIAL_THRESHOLD = 4;     // # pages in order to start readahead
+  static const int READAHEAD_SIZE = 256 * 1024;  // # bytes read ahead of the reader
+
+  bool           scan;         // true if the file is opened in 's' mode
+  mutable PageId lastRead;     // the last page read
+  mutable int    sequential;   // # pages read in order up to lastRead
+  mutable PageId readaheadEnd; // (last page read ahead + 1)
 
   //
-  // the following set of members implement LRU caching 
+  // the following members implement the memory-mapped mode
   //
-  static const int CACHE_COUNT = 10;
-
-  static int cacheClock; // clock tick counter for LRU policy
-
-  // the actual cache data structure
-  static struct cacheStruct {
-    int    fd;              // file id of the cached page
-    PageId pid;             // page id of the cached page
-    int    lastAccessed;    // the last time the cached page was accessed
-                            //   (lastAccessed == 0) means that the buffer is empty
-    char buffer[PAGE_SIZE]; // the buffer used for caching
-  } readCache[CACHE_COUNT];
+  static const size_t MIN_MAP_SIZE = 64 * 1024 * 1024;
+
+  bool           mapped;    // true if the file is opened in 'm' mode
+  mutable char*  mapAddr;   // the address of the current mapping
+  mutable size_t mapSize;   // the length of the current mapping
+  // the mappings replaced by a larger one. they are unmapped on close()
+  // so that the pointers handed out by readMapped() stay valid.
+  mutable std::vector<std::pair<char*, size_t> > oldMaps;
+
+  static pthread_mutex_t mapLock;  // serializes remap()
+
+  static const int MAX_IO_RUN = 64;  // max # pages read or written by one system call
 
   static int readCount;  // total # of page reads 
   static int writeCount; // total # of page writes 
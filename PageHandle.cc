@@ -0,0 +1,38 @@
+#include "Bruinbase.h"
+#include "PageHandle.h"
+
+PageHandle::PageHandle()
+{
+  frame = NULL;
+  page = NULL;
+}
+
+PageHandle::PageHandle(const PageHandle& handle)
+{
+  frame = handle.frame;
+  page = handle.page;
+  if (frame != NULL) BufferPool::pin(frame);
+}
+
+PageHandle& PageHandle::operator= (const PageHandle& handle)
+{
+  // pin the new frame first, in case both handles refer to the same frame
+  if (handle.frame != NULL) BufferPool::pin(handle.frame);
+  release();
+  frame = handle.frame;
+  page = handle.page;
+
+  return *this;
+}
+
+PageHandle::~PageHandle()
+{
+  release();
+}
+
+void PageHandle::release()
+{
+  if (frame != NULL) BufferPool::unpin(frame, false);
+  frame = NULL;
+  page = NULL;
+}
@@ -0,0 +1,43 @@
+#ifndef PAGEHANDLE_H
+#define PAGEHANDLE_H
+
+#include "Bruinbase.h"
+#include "BufferPool.h"
+
+/**
+ * A read-only view of a page returned by PageFile::readPage().
+ * The frame holding the page stays pinned in the BufferPool while the
+ * handle refers to it and is unpinned when the handle is released,
+ * assigned or destroyed. Copying a handle pins the frame once more.
+ * For a file opened in 'm' mode, the handle points into the mapping.
+ */
+class PageHandle {
+ public:
+  PageHandle();
+  PageHandle(const PageHandle& handle);
+  PageHandle& operator= (const PageHandle& handle);
+  ~PageHandle();
+
+  /**
+   * @return pointer to the content of the page. NULL if the handle is empty
+   */
+  const char* data() const { return page; }
+
+  /**
+   * @return true if the handle does not refer to a page
+   */
+  bool empty() const { return page == NULL; }
+
+  /**
+   * unpin the page and make the handle empty.
+   */
+  void release();
+
+ private:
+  BufferPool::Frame* frame;  // the pinned frame (NULL for a mapped page)
+  const char*        page;   // the content of the page
+
+  friend class PageFile;
+};
+
+#endif // PAGEHANDLE_H
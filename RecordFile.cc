@@ -2,59 +2,193 @@
 
 #include "Bruinbase.h"
 #include "RecordFile.h"
+#include "PageHandle.h"
+#include <climits>
 #include <cstring>
+#include <set>
+#include <vector>
+#include <unistd.h>
 
 using std::string;
 
 //
-// helper functions for page manipultation
+// the layout of a record page
 //
 
-// compute the pointer to the n'th slot in a page
-static char* slotPtr(char* page, int n);
+// the header in page 0 of the file
+struct RecordFileHeader {
+  int version;      // RECORD_FORMAT_VERSION
+  int layout;       // the layout of the last page
+  PageId first;     // the first record page (-1 if there is none)
+  PageId last;      // the last record page, where records are appended
+  int lastCount;    // # slots of the last page
+  int deadCount;    // # deleted records whose slots are not reused yet
+  RecordFile::Stats stats;  // the statistics of the file
+};
 
-// read the record in the n'th slot in the page
-static void readSlot(const char* page, int n, int& key, std::string& value);
+// the page of the file header
+static const PageId HEADER_PID = 0;
 
-// write the record to the n'th slot in the page
-static void writeSlot(char* page, int n, int key, const std::string& value);
+// the header at the beginning of a record page
+struct RecordPageHeader {
+  int count;        // # slots in the page
+  int dataStart;    // the offset of the first byte of the records
+  PageId next;      // the next record page (-1 for the last page)
+  int layout;       // ROW_LAYOUT or PAX_LAYOUT
+  int liveCount;    // # slots holding a record
+  int freeSlot;     // the first slot of a deleted record (-1 for none)
+  int stubCount;    // # slots holding the stub of a moved record
+};
 
-// get # records stored in the page
-static int getRecordCount(const char* page);
+// an entry of the slot directory that follows the header, or
+// the array of keys in a PAX page
+struct RecordSlot {
+  unsigned short offset;  // the offset of the record in the page,
+                          // DEAD_RECORD if the record is deleted
+  unsigned short length;  // # bytes of the record (key and value),
+                          // with OVERFLOW_RECORD set for a long value
+                          // and FORWARD_RECORD or MOVED_RECORD set for
+                          // a record moved by an update.
+                          // the next free slot if the record is deleted
+};
+
+// the offset of a deleted record, which no record can start at.
+// the free slots of a page are chained through their length
+static const unsigned short DEAD_RECORD = 0;
+
+// the end of the chain of free slots
+static const unsigned short NO_FREE_SLOT = 0xFFFF;
+
+// the flag in RecordSlot::length of a record whose value is stored in
+// overflow pages. such a record is (key, OverflowRef, value prefix)
+// or (OverflowRef, value prefix) in a PAX page
+static const unsigned short OVERFLOW_RECORD = 0x8000;
+
+// the flag of the stub left in the slot of a record that an update moved
+// to another page. the stub is (key, RecordId of the record) or
+// (RecordId of the record) in a PAX page
+static const unsigned short FORWARD_RECORD = 0x4000;
+
+// the flag of a record moved by an update. the RecordId of its stub
+// follows the key, so that the record is found by its old id
+static const unsigned short MOVED_RECORD = 0x2000;
+
+// the bits of RecordSlot::length that hold # bytes of the record
+static const unsigned short RECORD_LENGTH = 0x1FFF;
+
+// the reference to the overflow pages of a long value
+struct OverflowRef {
+  long long length;   // the length of the whole value
+  PageId    first;    // the first overflow page
+};
+
+// the # bytes of a long value kept in its record
+static const int OVERFLOW_PREFIX_LENGTH = 64;
+
+// the header at the beginning of an overflow page
+struct OverflowPageHeader {
+  int    marker;      // OVERFLOW_PAGE in place of the slot count
+  int    length;      // # bytes of the value in this page
+  PageId next;        // the next page of the chain (-1 at the end)
+  PageId owner;       // the record page the value was written from
+};
+
+// the slot count of an overflow page, so that scans skip the page
+static const int OVERFLOW_PAGE = -1;
 
-// update # records stored in the page
-static void setRecordCount(char* page, int count);
+// records are stored in slotted pages linked from a header page with the
+// statistics of the file, tagged with their layout, deleted in place and
+// moved by updates behind a stub from this file format version on
+static const int RECORD_FORMAT_VERSION = 8;
 
+// a record page is compacted when its records take less than
+// 1 / SPARSE_PAGE_RATIO of the page
+static const int SPARSE_PAGE_RATIO = 2;
 
 //
-// helper functions for RecordId manipulation
+// helper functions for page manipultation
 //
 
-// postfix record id iterator
-RecordId operator++ (RecordId& rid, int)
-{
-  RecordId prid(rid);
+// initialize an empty record page
+static void initPage(char* page, int pageSize, int layout);
 
-  // if the end of a page is reached, move to the next page
-  if (++rid.sid >= RecordFile::RECORDS_PER_PAGE) {
-    rid.pid++;
-    rid.sid = 0;
-  }
+// get the slot directory of the page
+static const RecordSlot* getSlots(const char* page);
 
-  return prid;
-}
+// get # bytes free between the slot directory and the records
+static int freeSpace(const char* page);
 
-// prefix record id iterator
-RecordId& operator++ (RecordId& rid)
-{
-  // if the end of a page is reached, move to the next page
-  if (++rid.sid >= RecordFile::RECORDS_PER_PAGE) {
-    rid.pid++;
-    rid.sid = 0;
-  } 
+// get # bytes taken by the header, the live records and their slots
+static int liveSpace(const char* page);
 
-  return rid;
-}
+// get # bytes the page takes once it is compacted in place:
+// its header, the slot directory and the live records
+static int usedSpace(const char* page);
+
+// get # bytes of a record of length bytes in the page, with the reference
+// to its overflow pages if overflow is set and a RecordId if link is set
+static int recordSize(const char* page, int length, bool overflow, bool link);
+
+// get # bytes a new record of length bytes takes in the page,
+// with its slot unless a free slot is reused
+static int neededSpace(const char* page, int length, bool overflow, bool link);
+
+// check whether the n'th slot of the page holds a record
+static bool isLive(const char* page, int n);
+
+// check whether the n'th slot of the page holds a record read by scans,
+// i.e., a record that is not a stub
+static bool isScanned(const char* page, int n);
+
+// find the record in the n'th slot in the page. if the value is long,
+// value points to its prefix and true is returned with its overflow pages.
+// a stub has an empty value
+static bool readSlot(const char* page, int n, int& key, const char*& value,
+                     int& length, OverflowRef& ref);
+
+// get FORWARD_RECORD for a stub and MOVED_RECORD for a moved record,
+// with the RecordId stored in it, or 0 for any other record
+static int readLink(const char* page, int n, RecordId& link);
+
+// add the record to the page in a free slot or a new slot and return
+// the slot. the reference to the overflow pages is stored if it is not NULL,
+// and the RecordId of a stub or a moved record (given by flags) if link is
+static int addSlot(char* page, int key, const char* value, int length,
+                   const OverflowRef* ref, const RecordId* link, int flags);
+
+// check whether the record in the n'th slot can be replaced by a record
+// of size bytes, once the page is compacted if needed
+static bool fitsSlot(const char* page, int pageSize, int n, int size);
+
+// replace the record in the n'th slot, for which fitsSlot() is true.
+// the arguments are those of addSlot()
+static void rewriteSlot(char* page, int pageSize, int n, int key, const char* value,
+                        int length, const OverflowRef* ref, const RecordId* link, int flags);
+
+// store the record at the offset of the n'th slot
+static void storeRecord(char* page, int n, int key, const char* value, int length,
+                        const OverflowRef* ref, const RecordId* link, int flags);
+
+// delete the record in the n'th slot and put the slot on the free list
+static void deleteSlot(char* page, int n);
+
+// pack the live records of the page towards its end, so that the space
+// of the deleted records joins the free space
+static void compactPage(char* page, int pageSize);
+
+// get # records stored in the page
+static int getRecordCount(const char* page);
+
+// get the length of the whole value of the record in the n'th slot
+static long long getValueLength(const char* page, int n);
+
+// reset the statistics of an empty file
+static void clearStats(RecordFile::Stats& stats);
+
+
+//
+// helper functions for RecordId manipulation
+//
 
 // RecordId comparators
 bool operator < (const RecordId& r1, const RecordId& r2)
@@ -98,115 +232,959 @@ bool operator != (const RecordId& r1, const RecordId& r2)
 
 RecordFile::RecordFile()
 {
-  erid.pid = 0;
+  erid.pid = -1;
   erid.sid = 0;
+  first = -1;
+  deadCount = 0;
+  clearStats(stats);
+  layout = ROW_LAYOUT;
+  bulkPending = false;
+  headerDirty = false;
+  compacting = false;
 }
 
 RecordFile::RecordFile(const string& filename, char mode)
 {
+  bulkPending = false;
+  headerDirty = false;
+  compacting = false;
   open(filename, mode);
 }
 
-RC RecordFile::open(const string& filename, char mode)
+RC RecordFile::open(const string& filename, char mode, int pageSize, int newLayout)
 {
-  RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  RC     rc;
+  PageId pid;
 
   // open the page file
-  if ((rc = pf.open(filename, mode)) < 0) return rc;
+  if ((rc = pf.open(filename, mode, pageSize)) < 0) return rc;
+
+  // the records of older files are stored in fixed-size slots,
+  // or in record pages that are not linked from a header
+  if (pf.getFormatVersion() < RECORD_FORMAT_VERSION) {
+    pf.close();
+    return RC_INVALID_FILE_FORMAT;
+  }
   
   //
   // in the rest of this function, we set the end record id
   //
 
-  // get the end pid of the file
-  erid.pid = pf.endPid();
+  erid.pid = -1;
+  erid.sid = 0;
+  first = -1;
+  deadCount = 0;
+  clearStats(stats);
+  layout = newLayout;
+  headerDirty = false;
 
   // if the end pid is zero, the file is empty.
-  // set the end record id to (0, 0).
-  if (erid.pid == 0) {
-    erid.sid = 0;
+  // a new file gets its header page, and its end record id is (-1, 0)
+  if (pf.endPid() == 0) {
+    if (mode == 'w' || mode == 'W') {
+      headerDirty = true;
+      if ((rc = pf.allocatePage(HEADER_PID, pid)) < 0 || (rc = writeHeader()) < 0) {
+        pf.close();
+        return rc;
+      }
+    }
+    openZoneMap(filename, mode);
     return 0;
   }
 
-  // obtain # records in the last page to set sid of the end record id.
-  // read the last page of the file and get # records in the page.
-  // remeber that the id of the last page is endPid()-1 not endPid().
-  if ((rc = pf.read(--erid.pid, page)) < 0) {
-    // an error occurred during page read
-    erid.pid = erid.sid = 0;
+  // the header knows the first and the last record page and # slots
+  // of the last page, where new records go as long as they fit
+  if ((rc = readHeader()) < 0) {
+    erid.pid = -1;
+    erid.sid = 0;
+    first = -1;
     pf.close();
     return rc;
   }
 
-  // get # records in the last page
-  erid.sid = getRecordCount(page);
-  if (erid.sid >= RECORDS_PER_PAGE) {
-    // the last page is full. advance the end record id to the next page.
-    erid.pid++;
-    erid.sid = 0;
-  }
-  
+  openZoneMap(filename, mode);
+  return 0;
+}
+
+RC RecordFile::readHeader()
+{
+  RC         rc;
+  PageHandle page;
+  const RecordFileHeader* header;
+
+  if ((rc = pf.readPage(HEADER_PID, page)) < 0) return rc;
+  header = (const RecordFileHeader*) page.data();
+  if (header->version != RECORD_FORMAT_VERSION) return RC_INVALID_FILE_FORMAT;
+  if (header->last >= pf.endPid() || header->first >= pf.endPid()) return RC_INVALID_FILE_FORMAT;
+
+  first = header->first;
+  erid.pid = header->last;
+  erid.sid = header->lastCount;
+  deadCount = header->deadCount;
+  stats = header->stats;
+
+  // new pages get the layout of the last page
+  if (erid.pid >= 0) layout = header->layout;
+
+  return 0;
+}
+
+RC RecordFile::writeHeader()
+{
+  RC   rc;
+  char page[PageFile::MAX_PAGE_SIZE];
+  RecordFileHeader* header = (RecordFileHeader*) page;
+
+  if (!headerDirty) return 0;
+
+  memset(page, 0, pf.getPageSize());
+  header->version = RECORD_FORMAT_VERSION;
+  header->layout = layout;
+  header->first = first;
+  header->last = erid.pid;
+  header->lastCount = erid.sid;
+  header->deadCount = deadCount;
+  header->stats = stats;
+  if ((rc = pf.write(HEADER_PID, page)) < 0) return rc;
+  headerDirty = false;
+
   return 0;
 }
 
+void RecordFile::openZoneMap(const string& filename, char mode)
+{
+  string        name = filename + ".zone";
+  bool          empty = (erid.pid < 0);
+  ZoneMap::Zone zone;
+
+  // the pages of a file written without a zone map get none
+  if (mode == 'w' && !empty && ::access(name.c_str(), F_OK) != 0) return;
+  if (zones.open(name, mode, pf.getPageSize()) < 0) return;
+
+  // the last zone has to be that of the last page
+  if (empty ? zones.getCount() > 0
+            : (zones.read(zones.getCount() - 1, zone) < 0 || zone.pid != erid.pid)) {
+    zones.close();
+  }
+}
+
 RC RecordFile::close()
 {
-  erid.pid = 0;
+  RC rc, closeRc;
+
+  // write the last page of a bulk append and the header
+  // before the file is closed
+  rc = flushBulk();
+  bulkPending = false;
+  headerDirty = false;
+  erid.pid = -1;
   erid.sid = 0;
+  first = -1;
 
-  return pf.close();
+  if ((closeRc = zones.close()) < 0 && rc == 0) rc = closeRc;
+  closeRc = pf.close();
+  return (rc < 0) ? rc : closeRc;
 }
 
 RC RecordFile::read(const RecordId& rid, int& key, string& value) const
 {
-  RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  RC          rc;
+  OverflowRef ref;
+  PageHandle  page;
+  const char* data;
+  int         length, sid;
   
   // check whether the rid is in the valid range
-  if (rid.pid < 0 || rid.pid > erid.pid) return RC_INVALID_RID;
-  if (rid.sid < 0 || rid.sid >= RecordFile::RECORDS_PER_PAGE) return RC_INVALID_RID;
-  if (rid >= erid) return RC_INVALID_RID;
+  if (rid.pid <= HEADER_PID || rid.pid >= pf.endPid()) return RC_INVALID_RID;
+  if (rid.sid < 0) return RC_INVALID_RID;
   
-  // read the page containing the record
-  if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  // pin the page containing the record without copying it
+  if ((rc = pf.readPage(rid.pid, page)) < 0) return rc;
+  if (!isLive(page.data(), rid.sid)) return RC_INVALID_RID;
+
+  // a record moved by an update is found through its stub
+  if ((rc = followStub(rid, page, sid)) < 0) return rc;
+
+  // read the record from the slot in the page,
+  // and a long value from its overflow pages
+  if (readSlot(page.data(), sid, key, data, length, ref)) {
+    return readOverflow(ref.first, ref.length, value);
+  }
+  value.assign(data, length);
+
+  return 0;
+}
+
+RC RecordFile::readPrefix(const RecordId& rid, int& key, string& prefix, bool& complete) const
+{
+  RC          rc;
+  OverflowRef ref;
+  PageHandle  page;
+  const char* data;
+  int         length, sid;
+  
+  // check whether the rid is in the valid range
+  if (rid.pid <= HEADER_PID || rid.pid >= pf.endPid()) return RC_INVALID_RID;
+  if (rid.sid < 0) return RC_INVALID_RID;
+  
+  if ((rc = pf.readPage(rid.pid, page)) < 0) return rc;
+  if (!isLive(page.data(), rid.sid)) return RC_INVALID_RID;
+  if ((rc = followStub(rid, page, sid)) < 0) return rc;
 
-  // read the record from the slot in the page
-  readSlot(page, rid.sid, key, value);
+  // read the record from the slot, leaving the overflow pages alone
+  complete = !readSlot(page.data(), sid, key, data, length, ref);
+  prefix.assign(data, length);
 
   return 0;
 }
 
+RC RecordFile::followStub(const RecordId& rid, PageHandle& page, int& sid) const
+{
+  RC       rc;
+  RecordId link;
+
+  sid = rid.sid;
+  if (readLink(page.data(), rid.sid, link) != FORWARD_RECORD) return 0;
+
+  // the stub is replaced by the record it points to
+  if (link.pid <= HEADER_PID || link.pid >= pf.endPid()) return RC_INVALID_FILE_FORMAT;
+  if ((rc = pf.readPage(link.pid, page)) < 0) return rc;
+  if (!isLive(page.data(), link.sid)) return RC_INVALID_FILE_FORMAT;
+  sid = link.sid;
+
+  return 0;
+}
+
+void RecordFile::startScan(ScanCursor& cursor) const
+{
+  // the scan follows the record pages from the first one
+  if (first < 0) {
+    cursor.rid = erid;
+  } else {
+    cursor.rid.pid = first;
+    cursor.rid.sid = 0;
+  }
+  cursor.last = cursor.rid;
+  cursor.page.release();
+  cursor.pid = -1;
+  cursor.zone = 0;
+}
+
+RC RecordFile::readForward(ScanCursor& cursor, int& key, const char*& value, int& length, bool& complete) const
+{
+  RC          rc;
+  OverflowRef ref;
+  RecordId&   rid = cursor.rid;
+  const RecordPageHeader* header;
+
+  if ((rc = seekRecord(cursor)) < 0) return rc;
+  header = (const RecordPageHeader*) cursor.page.data();
+
+  complete = !readSlot(cursor.page.data(), rid.sid, key, value, length, ref);
+
+  // a record moved by an update keeps the id of its stub
+  if (readLink(cursor.page.data(), rid.sid, cursor.last) != MOVED_RECORD) cursor.last = rid;
+
+  // at the end of a page, move to the next record page.
+  // the last page has no next page, as records are appended to it
+  if (++rid.sid >= header->count && rid.pid != erid.pid) {
+    rid.pid = header->next;
+    rid.sid = 0;
+    cursor.zone++;
+  }
+
+  return 0;
+}
+
+RC RecordFile::prefetch(const RecordId* rids, int count) const
+{
+  std::vector<PageId> pids;
+
+  for (int i = 0; i < count; i++) {
+    if (rids[i].pid > HEADER_PID && rids[i].pid < pf.endPid()) pids.push_back(rids[i].pid);
+  }
+  if (pids.empty()) return 0;
+
+  return pf.prefetch(&pids[0], pids.size());
+}
+
+RC RecordFile::readKeys(ScanCursor& cursor, const int*& keys, int& count) const
+{
+  RC        rc;
+  RecordId& rid = cursor.rid;
+  const RecordPageHeader* header;
+
+  if ((rc = seekRecord(cursor)) < 0) return rc;
+  header = (const RecordPageHeader*) cursor.page.data();
+  count = header->count - rid.sid;
+
+  // the keys of a PAX page without deleted records and stubs are read
+  // in place. the others are gathered from the records scanned
+  if (header->layout == PAX_LAYOUT && header->liveCount == header->count && header->stubCount == 0) {
+    keys = (const int*) (cursor.page.data() + sizeof(RecordPageHeader)) + rid.sid;
+  } else {
+    const RecordSlot* slots = getSlots(cursor.page.data());
+    const char* paxKeys = cursor.page.data() + sizeof(RecordPageHeader);
+    cursor.keys.resize(count);
+    count = 0;
+    for (int i = rid.sid; i < header->count; i++) {
+      if (!isScanned(cursor.page.data(), i)) continue;
+      if (header->layout == PAX_LAYOUT) {
+        memcpy(&cursor.keys[count++], paxKeys + i * sizeof(int), sizeof(int));
+      } else {
+        memcpy(&cursor.keys[count++], cursor.page.data() + slots[i].offset, sizeof(int));
+      }
+    }
+    keys = (count > 0) ? &cursor.keys[0] : NULL;
+  }
+
+  // move to the next record page, or to the end of the last page
+  if (rid.pid != erid.pid) {
+    rid.pid = header->next;
+    rid.sid = 0;
+    cursor.zone++;
+  } else {
+    rid.sid = header->count;
+  }
+
+  return 0;
+}
+
+RC RecordFile::readZone(const ScanCursor& cursor, ZoneMap::Zone& zone) const
+{
+  RC rc;
+
+  if (!zones.isOpen()) return RC_NO_SUCH_RECORD;
+  if ((rc = zones.read(cursor.zone, zone)) < 0) return rc;
+  if (zone.pid != cursor.rid.pid) return RC_NO_SUCH_RECORD;
+
+  return 0;
+}
+
+RC RecordFile::skipPage(ScanCursor& cursor) const
+{
+  RC            rc;
+  ZoneMap::Zone zone;
+
+  // skipping the last page ends the scan
+  if (cursor.rid.pid == erid.pid) {
+    cursor.rid = erid;
+    return 0;
+  }
+
+  // the next record page is found in its zone
+  if ((rc = zones.read(cursor.zone + 1, zone)) < 0) return rc;
+  cursor.rid.pid = zone.pid;
+  cursor.rid.sid = 0;
+  cursor.zone++;
+
+  return 0;
+}
+
+RC RecordFile::pinScanPage(ScanCursor& cursor) const
+{
+  RC        rc;
+  RecordId& rid = cursor.rid;
+
+  // check whether the cursor is in the valid range
+  if (rid.pid <= HEADER_PID || rid.pid >= pf.endPid() || rid.sid < 0) return RC_INVALID_CURSOR;
+
+  // pin the page when the cursor enters it. the previous page is
+  // released only now, since the last value read may point into it
+  if (cursor.page.empty() || cursor.pid != rid.pid) {
+    cursor.page.release();
+    cursor.pid = -1;
+    if ((rc = pf.readPage(rid.pid, cursor.page)) < 0) return rc;
+    cursor.pid = rid.pid;
+  }
+  if (rid.sid >= getRecordCount(cursor.page.data())) return RC_INVALID_CURSOR;
+
+  return 0;
+}
+
+RC RecordFile::seekRecord(ScanCursor& cursor) const
+{
+  RC        rc;
+  RecordId& rid = cursor.rid;
+  const RecordPageHeader* header;
+
+  while (rid != erid) {
+    if ((rc = pinScanPage(cursor)) < 0) return rc;
+    header = (const RecordPageHeader*) cursor.page.data();
+
+    // the deleted records and the stubs of moved records are passed over
+    while (rid.sid < header->count && !isScanned(cursor.page.data(), rid.sid)) rid.sid++;
+    if (rid.sid < header->count) return 0;
+
+    if (rid.pid == erid.pid) break;
+    rid.pid = header->next;
+    rid.sid = 0;
+    cursor.zone++;
+  }
+
+  // no record is left after the deleted ones
+  rid = erid;
+  return RC_END_OF_FILE;
+}
+
 RC RecordFile::append(int key, const std::string& value, RecordId& rid)
 {
   RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  // the records appended in bulk go to the disk first
+  if ((rc = flushBulk()) < 0) return rc;
+
+  // unless the file has no record page yet,
+  // we have to read the last page first
+  if (erid.pid >= 0 && (rc = pf.read(erid.pid, page)) < 0) return rc;
+
+  // write the record to a free slot or a new slot
+  if ((rc = appendToPage(page, key, value, rid)) < 0) return rc;
+
+  // write the page, its zone and the header to the disk
+  if ((rc = pf.write(rid.pid, page)) < 0) return rc;
+  if (zones.isOpen() && (rc = zones.flush()) < 0) return rc;
+  return writeHeader();
+}
+
+RC RecordFile::appendBulk(int key, const std::string& value, RecordId& rid)
+{
+  RC rc;
+
+  // the last page is read once when a bulk append starts
+  if (!bulkPending) {
+    bulkPage.resize(pf.getPageSize());
+    if (erid.pid >= 0 && (rc = pf.read(erid.pid, &bulkPage[0])) < 0) return rc;
+    bulkPending = true;
+  }
+
+  // the page is written when it is full or flushBulk() is called
+  return appendToPage(&bulkPage[0], key, value, rid);
+}
+
+RC RecordFile::flushBulk()
+{
+  RC rc;
 
-  // unless we are writing to the the first slot of an empty page,
-  // we have to read the page first
-  if (erid.sid > 0) {
-    if ((rc = pf.read(erid.pid, page)) < 0) return rc;
+  if (bulkPending) {
+    if ((rc = pf.write(erid.pid, &bulkPage[0])) < 0) return rc;
+    bulkPending = false;
+    if (zones.isOpen() && (rc = zones.flush()) < 0) return rc;
+  }
+
+  return writeHeader();
+}
+
+RC RecordFile::remove(const RecordId& rid)
+{
+  RC         rc;
+  PageHandle page;
+  RecordId   link;
+  long long  length;
+  int        sid;
+
+  // the last page may be kept in memory by a bulk append
+  if ((rc = flushBulk()) < 0) return rc;
+
+  if (rid.pid <= HEADER_PID || rid.pid >= pf.endPid()) return RC_INVALID_RID;
+  if (rid.sid < 0) return RC_INVALID_RID;
+  if ((rc = pf.readPage(rid.pid, page)) < 0) return rc;
+  if (!isLive(page.data(), rid.sid)) return RC_INVALID_RID;
+
+  // a record moved by an update is deleted with its stub
+  switch (readLink(page.data(), rid.sid, link)) {
+  case MOVED_RECORD:
+    page.release();
+    return remove(link);
+  case FORWARD_RECORD:
+    if ((rc = followStub(rid, page, sid)) < 0) return rc;
+    length = getValueLength(page.data(), sid);
+    page.release();
+    if ((rc = dropRecord(link, true)) < 0) return rc;
+    deadCount++;
+    break;
+  default:
+    length = getValueLength(page.data(), rid.sid);
+  }
+  page.release();
+
+  if ((rc = dropRecord(rid, true)) < 0) return rc;
+  deadCount++;
+
+  // the key bounds are reset once the file is empty
+  stats.valueBytes -= length;
+  if (--stats.recordCount == 0) {
+    stats.minKey = INT_MAX;
+    stats.maxKey = INT_MIN;
+  }
+  headerDirty = true;
+  return writeHeader();
+}
+
+RC RecordFile::update(const RecordId& rid, const string& value, MoveCallback moved, void* arg)
+{
+  RC          rc;
+  char        page[PageFile::MAX_PAGE_SIZE];
+  OverflowRef ref, oldRef;
+  RecordId    link, to;
+  const char* data;
+  bool        overflow = (int) value.size() > getMaxInlineLength();
+  bool        oldOverflow;
+  int         length = overflow ? OVERFLOW_PREFIX_LENGTH : value.size();
+  int         key, oldLength;
+
+  // the last page may be kept in memory by a bulk append
+  if ((rc = flushBulk()) < 0) return rc;
+
+  if (rid.pid <= HEADER_PID || rid.pid >= pf.endPid()) return RC_INVALID_RID;
+  if (rid.sid < 0) return RC_INVALID_RID;
+  if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  if (!isLive(page, rid.sid)) return RC_INVALID_RID;
+
+  // a record moved by an earlier update is updated through its stub
+  switch (readLink(page, rid.sid, link)) {
+  case MOVED_RECORD:
+    return update(link, value, moved, arg);
+  case FORWARD_RECORD:
+    return updateMoved(rid, link, value);
+  }
+  oldOverflow = readSlot(page, rid.sid, key, data, oldLength, oldRef);
+  stats.valueBytes += (long long) value.size() - (oldOverflow ? oldRef.length : oldLength);
+  headerDirty = true;
+
+  // a long value is written to new overflow pages first
+  if (overflow) {
+    ref.length = value.size();
+    if ((rc = writeOverflow(value, rid.pid, ref.first)) < 0) return rc;
+  }
+
+  if (fitsSlot(page, pf.getPageSize(), rid.sid, recordSize(page, length, overflow, false))) {
+    // the record is rewritten in its page
+    rewriteSlot(page, pf.getPageSize(), rid.sid, key, value.data(), length, overflow ? &ref : NULL, NULL, 0);
+    if ((rc = pf.write(rid.pid, page)) < 0) return rc;
+    if (zones.isOpen() && (rc = zones.widen(rid.pid, key, value.data(), length)) < 0) return rc;
+  } else if (fitsSlot(page, pf.getPageSize(), rid.sid, recordSize(page, 0, false, true))) {
+    // the record moves to the last page and leaves a stub with its new
+    // id behind, so that it is still found by its id
+    if ((rc = appendRecord(key, value.data(), length, overflow ? &ref : NULL, &rid, to)) < 0) return rc;
+    if ((rc = rewriteStub(rid, key, to)) < 0) return rc;
   } else {
-    // if this is the first slot of an empty page
-    // we can simply initialize the page with zeros
-    memset(page, 0, PageFile::PAGE_SIZE);
-  }
-    
-  // write the record to the first empty slot 
-  writeSlot(page, erid.sid, key, value);
-
-  // the first four bytes in the page stores # records in the page.
-  // update this number.
-  setRecordCount(page, erid.sid + 1);
-
-  // write the page to the disk
-  if ((rc = pf.write(erid.pid, page)) < 0) return rc;
-    
-  // we need to output the rid of the record slot
-  rid = erid;
+    // not even the stub fits in the page: the record moves without one,
+    // and moved is told its new id
+    deleteSlot(page, rid.sid);
+    if ((rc = pf.write(rid.pid, page)) < 0) return rc;
+    deadCount++;
+    headerDirty = true;
+    if ((rc = appendRecord(key, value.data(), length, overflow ? &ref : NULL, NULL, to)) < 0) return rc;
+    if (moved && (rc = moved(arg, key, rid, to)) < 0) return rc;
+  }
 
-  // advance the end record id by one to the next empty slot
-  ++erid;
+  // the old value is freed once the new one is stored
+  if (oldOverflow && (rc = freeOverflow(oldRef.first)) < 0) return rc;
+  return writeHeader();
+}
+
+RC RecordFile::updateMoved(const RecordId& stub, const RecordId& target, const string& value)
+{
+  RC          rc;
+  char        page[PageFile::MAX_PAGE_SIZE];
+  OverflowRef ref, oldRef;
+  RecordId    to;
+  const char* data;
+  bool        overflow = (int) value.size() > getMaxInlineLength();
+  bool        oldOverflow;
+  int         length = overflow ? OVERFLOW_PREFIX_LENGTH : value.size();
+  int         key, oldLength;
+
+  if (target.pid <= HEADER_PID || target.pid >= pf.endPid()) return RC_INVALID_FILE_FORMAT;
+  if ((rc = pf.read(target.pid, page)) < 0) return rc;
+  if (!isLive(page, target.sid)) return RC_INVALID_FILE_FORMAT;
+  oldOverflow = readSlot(page, target.sid, key, data, oldLength, oldRef);
+  stats.valueBytes += (long long) value.size() - (oldOverflow ? oldRef.length : oldLength);
+  headerDirty = true;
+
+  if (overflow) {
+    ref.length = value.size();
+    if ((rc = writeOverflow(value, target.pid, ref.first)) < 0) return rc;
+  }
+
+  if (fitsSlot(page, pf.getPageSize(), target.sid, recordSize(page, length, overflow, true))) {
+    // the moved record is rewritten where it is
+    rewriteSlot(page, pf.getPageSize(), target.sid, key, value.data(), length, overflow ? &ref : NULL, &stub, MOVED_RECORD);
+    if ((rc = pf.write(target.pid, page)) < 0) return rc;
+    if (zones.isOpen() && (rc = zones.widen(target.pid, key, value.data(), length)) < 0) return rc;
+    if (oldOverflow && (rc = freeOverflow(oldRef.first)) < 0) return rc;
+  } else {
+    // the record moves on to the last page, where the stub points next,
+    // and the old record goes with its value
+    if ((rc = appendRecord(key, value.data(), length, overflow ? &ref : NULL, &stub, to)) < 0) return rc;
+    if ((rc = rewriteStub(stub, key, to)) < 0) return rc;
+    if ((rc = dropRecord(target, true)) < 0) return rc;
+    deadCount++;
+    headerDirty = true;
+  }
+
+  return writeHeader();
+}
+
+RC RecordFile::compact(MoveCallback moved, void* arg)
+{
+  RC          rc;
+  PageHandle  handle;
+  char        page[PageFile::MAX_PAGE_SIZE];
+  OverflowRef ref;
+  const char* value;
+  const RecordPageHeader* header;
+  int         key, length;
+  PageId      pid, next, prev = -1;
+  RecordId    from;
+  std::set<PageId> kept;
+
+  if ((rc = flushBulk()) < 0) return rc;
+  if (erid.pid < 0) return 0;
+
+  // the records are moved to the last page, which is kept in memory
+  // like in a bulk append
+  bulkPage.resize(pf.getPageSize());
+  if ((rc = pf.read(erid.pid, &bulkPage[0])) < 0) return rc;
+  bulkPending = true;
+
+  // the zones and the count of deleted records are rebuilt
+  // for the pages that are kept, in their order
+  if (zones.isOpen()) zones.clear();
+  compacting = true;
+  deadCount = 0;
+
+  for (pid = first; pid >= 0; pid = next) {
+    if (pid == erid.pid) {
+      header = (const RecordPageHeader*) &bulkPage[0];
+    } else {
+      if ((rc = pf.readPage(pid, handle)) < 0) goto exit_compact;
+      header = (const RecordPageHeader*) handle.data();
+    }
+    next = header->next;
+
+    // an empty last page is freed, and the page before it becomes the last
+    if (pid == erid.pid && header->liveCount == 0) {
+      if ((rc = pf.freePage(pid)) < 0) goto exit_compact;
+      stats.pageCount--;
+      erid.pid = prev;
+      erid.sid = 0;
+      bulkPending = (prev >= 0);
+      if (prev < 0) {
+        first = -1;
+      } else {
+        if ((rc = pf.read(prev, &bulkPage[0])) < 0) goto exit_compact;
+        ((RecordPageHeader*) &bulkPage[0])->next = -1;
+        erid.sid = getRecordCount(&bulkPage[0]);
+      }
+      break;
+    }
+
+    // a sparse page other than the last one is emptied into the last page
+    // and unlinked from the file
+    if (pid != erid.pid && liveSpace(handle.data()) * SPARSE_PAGE_RATIO < pf.getPageSize()) {
+      for (from.pid = pid, from.sid = 0; from.sid < header->count; from.sid++) {
+        if (!isLive(handle.data(), from.sid)) continue;
+        if ((rc = moveRecord(handle.data(), from, moved, arg, kept)) < 0) goto exit_compact;
+      }
+      handle.release();
+
+      if (prev < 0) {
+        first = next;
+      } else {
+        if ((rc = pf.read(prev, page)) < 0) goto exit_compact;
+        ((RecordPageHeader*) page)->next = next;
+        if ((rc = pf.write(prev, page)) < 0) goto exit_compact;
+      }
+      headerDirty = true;
+      if ((rc = pf.freePage(pid)) < 0) goto exit_compact;
+      stats.pageCount--;
+      continue;
+    }
+
+    // the page is kept with its zone
+    deadCount += header->count - header->liveCount;
+    kept.insert(pid);
+    if (zones.isOpen()) {
+      const char* data = (pid == erid.pid) ? &bulkPage[0] : handle.data();
+      for (int i = 0; i < header->count; i++) {
+        if (!isScanned(data, i)) continue;
+        readSlot(data, i, key, value, length, ref);
+        if ((rc = zones.add(pid, key, value, length)) < 0) goto exit_compact;
+      }
+    }
+    handle.release();
+    prev = pid;
+    if (pid == erid.pid) break;
+  }
+
+  exit_compact:
+  handle.release();
+  compacting = false;
+  headerDirty = true;
+  if (rc < 0) {
+    bulkPending = false;
+    return rc;
+  }
+  return flushBulk();
+}
+
+RC RecordFile::moveRecord(const char* page, const RecordId& from, MoveCallback moved, void* arg,
+                          const std::set<PageId>& kept)
+{
+  RC          rc;
+  PageHandle  handle;
+  OverflowRef ref;
+  RecordId    link, at = from, to;
+  const char* data = page;
+  const char* value;
+  string      copy;
+  int         key, length;
+  int         flags = readLink(page, from.sid, link);
+  bool        overflow;
+
+  // a moved record whose stub is in the same page goes with the stub
+  if (flags == MOVED_RECORD && link.pid == from.pid) return 0;
+
+  // a stub is resolved: the record it points to moves in its place
+  if (flags == FORWARD_RECORD) {
+    at = link;
+    if (at.pid == erid.pid) {
+      data = &bulkPage[0];
+    } else if (at.pid != from.pid) {
+      if ((rc = pf.readPage(at.pid, handle)) < 0) return rc;
+      data = handle.data();
+    }
+    if (!isLive(data, at.sid)) return RC_INVALID_FILE_FORMAT;
+  }
+  overflow = readSlot(data, at.sid, key, value, length, ref);
+
+  // the last page is started anew when the record does not fit in it
+  if (data == &bulkPage[0]) {
+    copy.assign(value, length);
+    value = copy.data();
+  }
+  if ((rc = reservePage(&bulkPage[0], length, overflow, flags == MOVED_RECORD)) < 0) return rc;
+  if ((rc = addRecord(&bulkPage[0], key, value, length, overflow ? &ref : NULL,
+                      (flags == MOVED_RECORD) ? &link : NULL, to)) < 0) return rc;
+  handle.release();
+
+  // the stub of a moved record is pointed to its new place.
+  // the record keeps its id, which is that of the stub
+  if (flags == MOVED_RECORD) {
+    if (link.pid != erid.pid) return rewriteStub(link, key, to);
+    rewriteSlot(&bulkPage[0], pf.getPageSize(), link.sid, key, "", 0, NULL, &to, FORWARD_RECORD);
+    return 0;
+  }
+
+  // the record a stub pointed to is deleted in its page, whose deleted
+  // records are counted when it is walked unless it was walked already
+  if (at.pid != from.pid) {
+    if (at.pid == erid.pid) {
+      deleteSlot(&bulkPage[0], at.sid);
+    } else if ((rc = dropRecord(at, false)) < 0) {
+      return rc;
+    }
+    if (kept.count(at.pid) > 0) deadCount++;
+  }
+
+  return moved ? moved(arg, key, from, to) : 0;
+}
+
+RC RecordFile::appendRecord(int key, const char* value, int length, const OverflowRef* ref,
+                            const RecordId* home, RecordId& rid)
+{
+  RC   rc;
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  if (erid.pid >= 0 && (rc = pf.read(erid.pid, page)) < 0) return rc;
+  if ((rc = reservePage(page, length, ref != NULL, home != NULL)) < 0) return rc;
+  if ((rc = addRecord(page, key, value, length, ref, home, rid)) < 0) return rc;
+  if ((rc = pf.write(rid.pid, page)) < 0) return rc;
+  if (zones.isOpen() && (rc = zones.flush()) < 0) return rc;
+
+  return 0;
+}
+
+RC RecordFile::rewriteStub(const RecordId& stub, int key, const RecordId& to)
+{
+  RC   rc;
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  if ((rc = pf.read(stub.pid, page)) < 0) return rc;
+  rewriteSlot(page, pf.getPageSize(), stub.sid, key, "", 0, NULL, &to, FORWARD_RECORD);
+  return pf.write(stub.pid, page);
+}
+
+RC RecordFile::dropRecord(const RecordId& rid, bool freeValue)
+{
+  RC          rc;
+  char        page[PageFile::MAX_PAGE_SIZE];
+  OverflowRef ref;
+  const char* value;
+  int         key, length;
+
+  if (rid.pid <= HEADER_PID || rid.pid >= pf.endPid()) return RC_INVALID_FILE_FORMAT;
+  if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  if (!isLive(page, rid.sid)) return RC_INVALID_FILE_FORMAT;
+
+  // the overflow pages of a long value are freed with the record
+  if (readSlot(page, rid.sid, key, value, length, ref) && freeValue &&
+      (rc = freeOverflow(ref.first)) < 0) return rc;
+
+  // the slot stays as a tombstone, so that the sids of the other
+  // records do not change. its space is reused by compaction
+  deleteSlot(page, rid.sid);
+  return pf.write(rid.pid, page);
+}
+
+RC RecordFile::appendToPage(char* page, int key, const std::string& value, RecordId& rid)
+{
+  RC          rc;
+  OverflowRef ref;
+  bool        overflow = (int) value.size() > getMaxInlineLength();
+  int         length = overflow ? OVERFLOW_PREFIX_LENGTH : value.size();
+
+  // make room for the record in the last page or start a new page
+  if ((rc = reservePage(page, length, overflow, false)) < 0) return rc;
+
+  // a long value is written to its overflow pages first
+  if (overflow) {
+    ref.length = value.size();
+    if ((rc = writeOverflow(value, erid.pid, ref.first)) < 0) return rc;
+  }
+  if ((rc = addRecord(page, key, value.data(), length, overflow ? &ref : NULL, NULL, rid)) < 0) return rc;
+
+  // the statistics count the new record
+  stats.recordCount++;
+  stats.valueBytes += value.size();
+  if (key < stats.minKey) stats.minKey = key;
+  if (key > stats.maxKey) stats.maxKey = key;
+
+  return 0;
+}
+
+RC RecordFile::reservePage(char* page, int length, bool overflow, bool link)
+{
+  RC     rc;
+  PageId pid = erid.pid;
+
+  if (erid.pid >= 0) {
+    // the record fits in the free space of the last page,
+    // or in the space of its deleted records once they are packed
+    int needed = neededSpace(page, length, overflow, link);
+    if (freeSpace(page) >= needed) return 0;
+    if (pf.getPageSize() - usedSpace(page) >= needed) {
+      compactPage(page, pf.getPageSize());
+      return 0;
+    }
+
+    // the new page may come after overflow pages,
+    // so the full page is linked to it
+    if ((rc = pf.allocatePage(pid, erid.pid)) < 0) return rc;
+    ((RecordPageHeader*) page)->next = erid.pid;
+    if ((rc = pf.write(pid, page)) < 0) return rc;
+  } else {
+    if ((rc = pf.allocatePage(HEADER_PID + 1, erid.pid)) < 0) return rc;
+    first = erid.pid;
+  }
+
+  // the new page is the last page of the file
+  initPage(page, pf.getPageSize(), layout);
+  erid.sid = 0;
+  stats.pageCount++;
+  headerDirty = true;
+
+  return 0;
+}
+
+RC RecordFile::addRecord(char* page, int key, const char* value, int length,
+                         const OverflowRef* ref, const RecordId* home, RecordId& rid)
+{
+  RC rc;
+
+  // write the record to a free slot, or to a new slot at the end
+  rid.pid = erid.pid;
+  rid.sid = addSlot(page, key, value, length, ref, home, home ? MOVED_RECORD : 0);
+  if (rid.sid == erid.sid) {
+    erid.sid++;
+  } else if (!compacting) {
+    deadCount--;
+  }
+  headerDirty = true;
+
+  // extend the bounds of the page. compaction rebuilds the zones itself
+  if (!compacting && zones.isOpen() && (rc = zones.add(rid.pid, key, value, length)) < 0) return rc;
+
+  return 0;
+}
+
+RC RecordFile::writeOverflow(const string& value, PageId owner, PageId& first)
+{
+  RC   rc;
+  int  capacity = pf.getPageSize() - sizeof(OverflowPageHeader);
+  int  count = (value.size() + capacity - 1) / capacity;
+  char page[PageFile::MAX_PAGE_SIZE];
+  std::vector<PageId> pids(count);
+  OverflowPageHeader* header = (OverflowPageHeader*) page;
+
+  // allocate the whole chain first, so that its pages are adjacent
+  for (int i = 0; i < count; i++) {
+    if ((rc = pf.allocatePage(i > 0 ? pids[i - 1] : owner, pids[i])) < 0) return rc;
+  }
+
+  memset(page, 0, pf.getPageSize());
+  for (int i = 0; i < count; i++) {
+    size_t start = (size_t) i * capacity;
+
+    header->marker = OVERFLOW_PAGE;
+    header->length = (value.size() - start < (size_t) capacity) ? value.size() - start : capacity;
+    header->next = (i + 1 < count) ? pids[i + 1] : -1;
+    header->owner = owner;
+    memcpy(page + sizeof(OverflowPageHeader), value.data() + start, header->length);
+    if ((rc = pf.write(pids[i], page)) < 0) return rc;
+  }
+
+  first = pids[0];
+  return 0;
+}
+
+RC RecordFile::readOverflow(PageId first, long long length, string& value) const
+{
+  RC         rc;
+  PageHandle page;
+  const OverflowPageHeader* header;
+
+  value.clear();
+  value.reserve(length);
+
+  // follow the chain until the whole value is read
+  for (PageId pid = first; (long long) value.size() < length; pid = header->next) {
+    if (pid < 0) return RC_INVALID_FILE_FORMAT;
+    if ((rc = pf.readPage(pid, page)) < 0) return rc;
+    header = (const OverflowPageHeader*) page.data();
+    if (header->marker != OVERFLOW_PAGE) return RC_INVALID_FILE_FORMAT;
+    value.append(page.data() + sizeof(OverflowPageHeader), header->length);
+  }
+
+  return 0;
+}
+
+RC RecordFile::freeOverflow(PageId head)
+{
+  RC         rc;
+  PageHandle page;
+  PageId     next;
+
+  for (PageId pid = head; pid >= 0; pid = next) {
+    if ((rc = pf.readPage(pid, page)) < 0) return rc;
+    if (((const OverflowPageHeader*) page.data())->marker != OVERFLOW_PAGE) return RC_INVALID_FILE_FORMAT;
+    next = ((const OverflowPageHeader*) page.data())->next;
+    page.release();
+    if ((rc = pf.freePage(pid)) < 0) return rc;
+  }
 
   return 0;
 }
@@ -216,56 +1194,330 @@ const RecordId& RecordFile::endRid() const
   return erid;
 }
 
+RC RecordFile::nextRid(RecordId& rid) const
+{
+  RC         rc;
+  PageHandle page;
+
+  // the number of slots of the last page is known
+  if (rid.pid == erid.pid) {
+    rid.sid++;
+    return 0;
+  }
+  if ((rc = pf.readPage(rid.pid, page)) < 0) return rc;
+
+  // if the end of a page is reached, move to the next record page
+  // past the overflow pages
+  if (++rid.sid >= getRecordCount(page.data())) {
+    rid.pid = ((const RecordPageHeader*) page.data())->next;
+    rid.sid = 0;
+  }
+  return 0;
+}
+
+int RecordFile::getMaxInlineLength() const
+{
+  // a record may take a quarter of the page with its slot,
+  // and its length has to fit in the slot with the id of its stub
+  int length = (pf.getPageSize() - (int) sizeof(RecordPageHeader)) / 4 - (int) (sizeof(RecordSlot) + sizeof(int));
+  int limit = RECORD_LENGTH - (int) (sizeof(int) + sizeof(RecordId));
+
+  return (length < limit) ? length : limit;
+}
+
+static void initPage(char* page, int pageSize, int layout)
+{
+  RecordPageHeader* header = (RecordPageHeader*) page;
+
+  // the records are added from the end of the page
+  header->count = 0;
+  header->dataStart = pageSize;
+  header->next = -1;
+  header->layout = layout;
+  header->liveCount = 0;
+  header->freeSlot = -1;
+  header->stubCount = 0;
+}
+
+static const RecordSlot* getSlots(const char* page)
+{
+  const RecordPageHeader* header = (const RecordPageHeader*) page;
+  const char* slots = page + sizeof(RecordPageHeader);
+
+  // the keys of a PAX page come before the slot directory
+  if (header->layout == RecordFile::PAX_LAYOUT) slots += header->count * sizeof(int);
+  return (const RecordSlot*) slots;
+}
+
+static int freeSpace(const char* page)
+{
+  const RecordPageHeader* header = (const RecordPageHeader*) page;
+  int entrySize = sizeof(RecordSlot);
+
+  if (header->layout == RecordFile::PAX_LAYOUT) entrySize += sizeof(int);
+  return header->dataStart - sizeof(RecordPageHeader) - header->count * entrySize;
+}
+
+static int liveSpace(const char* page)
+{
+  const RecordPageHeader* header = (const RecordPageHeader*) page;
+  const RecordSlot* slots = getSlots(page);
+  int entrySize = sizeof(RecordSlot);
+  int used = sizeof(RecordPageHeader);
+
+  if (header->layout == RecordFile::PAX_LAYOUT) entrySize += sizeof(int);
+  for (int i = 0; i < header->count; i++) {
+    if (slots[i].offset != DEAD_RECORD) used += entrySize + (slots[i].length & RECORD_LENGTH);
+  }
+  return used;
+}
+
+static int usedSpace(const char* page)
+{
+  const RecordPageHeader* header = (const RecordPageHeader*) page;
+  int entrySize = sizeof(RecordSlot);
+
+  // the slots of the deleted records stay in the directory
+  if (header->layout == RecordFile::PAX_LAYOUT) entrySize += sizeof(int);
+  return liveSpace(page) + (header->count - header->liveCount) * entrySize;
+}
+
+static int recordSize(const char* page, int length, bool overflow, bool link)
+{
+  bool pax = (((const RecordPageHeader*) page)->layout == RecordFile::PAX_LAYOUT);
+
+  return length + (overflow ? sizeof(OverflowRef) : 0) + (link ? sizeof(RecordId) : 0) + (pax ? 0 : sizeof(int));
+}
+
+static int neededSpace(const char* page, int length, bool overflow, bool link)
+{
+  const RecordPageHeader* header = (const RecordPageHeader*) page;
+  bool pax = (header->layout == RecordFile::PAX_LAYOUT);
+  int needed = recordSize(page, length, overflow, link);
+
+  // a new slot is added unless a free slot is reused
+  if (header->freeSlot < 0) needed += sizeof(RecordSlot) + (pax ? sizeof(int) : 0);
+  return needed;
+}
+
+static bool isLive(const char* page, int n)
+{
+  const RecordPageHeader* header = (const RecordPageHeader*) page;
+
+  // overflow pages have no slots
+  if (header->count == OVERFLOW_PAGE || n < 0 || n >= header->count) return false;
+  return getSlots(page)[n].offset != DEAD_RECORD;
+}
+
+static bool isScanned(const char* page, int n)
+{
+  const RecordSlot* slot = getSlots(page) + n;
+
+  return slot->offset != DEAD_RECORD && !(slot->length & FORWARD_RECORD);
+}
+
 static int getRecordCount(const char* page)
 {
-  int count;
+  // the header of a page starts with # records in the page
+  return ((const RecordPageHeader*) page)->count;
+}
+
+static long long getValueLength(const char* page, int n)
+{
+  OverflowRef ref;
+  const char* value;
+  int key, length;
+
+  // a long value knows its length in its reference
+  return readSlot(page, n, key, value, length, ref) ? ref.length : length;
+}
+
+static void clearStats(RecordFile::Stats& stats)
+{
+  stats.recordCount = 0;
+  stats.pageCount = 0;
+  stats.minKey = INT_MAX;
+  stats.maxKey = INT_MIN;
+  stats.valueBytes = 0;
+}
+
+static bool readSlot(const char* page, int n, int& key, const char*& value,
+                     int& length, OverflowRef& ref)
+{
+  // find the record through the slot directory after the header
+  const RecordSlot* slot = getSlots(page) + n;
+  const char* ptr = page + slot->offset;
+
+  length = slot->length & RECORD_LENGTH;
+
+  // read the key from the record, or from the key array of a PAX page
+  if (((const RecordPageHeader*) page)->layout == RecordFile::PAX_LAYOUT) {
+    memcpy(&key, page + sizeof(RecordPageHeader) + n * sizeof(int), sizeof(int));
+  } else {
+    memcpy(&key, ptr, sizeof(int));
+    ptr += sizeof(int);
+    length -= sizeof(int);
+  }
+  value = ptr;
+
+  // a stub keeps only the id of the record, which a moved record
+  // keeps before its value
+  if (slot->length & FORWARD_RECORD) {
+    length = 0;
+    return false;
+  }
+  if (slot->length & MOVED_RECORD) {
+    value += sizeof(RecordId);
+    length -= sizeof(RecordId);
+  }
+
+  // a long value is preceded by the reference to its overflow pages
+  if (slot->length & OVERFLOW_RECORD) {
+    memcpy(&ref, value, sizeof(OverflowRef));
+    value += sizeof(OverflowRef);
+    length -= sizeof(OverflowRef);
+    return true;
+  }
+  return false;
+}
+
+static int readLink(const char* page, int n, RecordId& link)
+{
+  const RecordSlot* slot = getSlots(page) + n;
+  int flags = slot->length & (FORWARD_RECORD | MOVED_RECORD);
 
-  // the first four bytes of a page contains # records in the page
-  memcpy(&count, page, sizeof(int));
-  return count;
+  // the id follows the key of a ROW page
+  if (flags) {
+    int keySize = (((const RecordPageHeader*) page)->layout == RecordFile::PAX_LAYOUT) ? 0 : sizeof(int);
+    memcpy(&link, page + slot->offset + keySize, sizeof(RecordId));
+  }
+  return flags;
 }
 
-static void setRecordCount(char* page, int count)
+static int addSlot(char* page, int key, const char* value, int length,
+                   const OverflowRef* ref, const RecordId* link, int flags)
 {
-  // the first four bytes of a page contains # records in the page
-  memcpy(page, &count, sizeof(int));
+  RecordPageHeader* header = (RecordPageHeader*) page;
+  bool pax = (header->layout == RecordFile::PAX_LAYOUT);
+  int size = recordSize(page, length, ref != NULL, link != NULL);
+  int* keys = (int*) (page + sizeof(RecordPageHeader));
+  RecordSlot* slot;
+  int n;
+
+  if (header->freeSlot >= 0) {
+    // the first free slot is taken off the free list
+    n = header->freeSlot;
+    slot = (RecordSlot*) getSlots(page) + n;
+    header->freeSlot = (slot->length == NO_FREE_SLOT) ? -1 : slot->length;
+  } else if (pax) {
+    // a PAX page appends the key to its key array,
+    // which moves the slot directory to make room
+    n = header->count++;
+    memmove(keys + n + 1, keys + n, n * sizeof(RecordSlot));
+    slot = (RecordSlot*) (keys + n + 1) + n;
+  } else {
+    n = header->count++;
+    slot = (RecordSlot*) getSlots(page) + n;
+  }
+
+  // the record is stored right before the records already in the page
+  slot->offset = header->dataStart - size;
+  header->dataStart = slot->offset;
+  header->liveCount++;
+  storeRecord(page, n, key, value, length, ref, link, flags);
+  if (flags & FORWARD_RECORD) header->stubCount++;
+
+  return n;
 }
 
-static char* slotPtr(char* page, int n) 
+static bool fitsSlot(const char* page, int pageSize, int n, int size)
 {
-  // compute the location of the n'th slot in a page.
-  // remember that the first four bytes in a page is used to store
-  // # records in the page and each slot consists of an integer and
-  // a string of length MAX_VALUE_LENGTH
-  return (page+sizeof(int)) + (sizeof(int)+RecordFile::MAX_VALUE_LENGTH)*n;
+  // the record takes the place of the old one or the free space,
+  // or the space of the old one and of the deleted records once packed
+  int old = getSlots(page)[n].length & RECORD_LENGTH;
+
+  return size <= old || size <= freeSpace(page) || size <= pageSize - usedSpace(page) + old;
 }
 
-static void readSlot(const char* page, int n, int& key, std::string& value)
+static void rewriteSlot(char* page, int pageSize, int n, int key, const char* value,
+                        int length, const OverflowRef* ref, const RecordId* link, int flags)
 {
-  // compute the location of the record
-  char *ptr = slotPtr(const_cast<char*>(page), n);
+  RecordPageHeader* header = (RecordPageHeader*) page;
+  RecordSlot* slot = (RecordSlot*) getSlots(page) + n;
+  int size = recordSize(page, length, ref != NULL, link != NULL);
 
-  // read the key 
-  memcpy(&key, ptr, sizeof(int));
+  if (slot->length & FORWARD_RECORD) header->stubCount--;
+  if (flags & FORWARD_RECORD) header->stubCount++;
 
-  // read the value
-  value.assign(ptr + sizeof(int));
+  // a shorter record is written over the old one. a longer one goes to
+  // the free space, which takes the old record once the page is packed
+  if (size > (slot->length & RECORD_LENGTH)) {
+    if (size > freeSpace(page)) {
+      slot->length = 0;
+      compactPage(page, pageSize);
+    }
+    header->dataStart -= size;
+    slot->offset = header->dataStart;
+  }
+  storeRecord(page, n, key, value, length, ref, link, flags);
 }
 
-static void writeSlot(char* page, int n, int key, const std::string& value)
+static void storeRecord(char* page, int n, int key, const char* value, int length,
+                        const OverflowRef* ref, const RecordId* link, int flags)
 {
-  // compute the location of the record
-  char *ptr = slotPtr(page, n);
+  bool pax = (((const RecordPageHeader*) page)->layout == RecordFile::PAX_LAYOUT);
+  RecordSlot* slot = (RecordSlot*) getSlots(page) + n;
+  char* ptr = page + slot->offset;
 
-  // store the key
-  memcpy(ptr, &key, sizeof(int));
+  slot->length = recordSize(page, length, ref != NULL, link != NULL) | flags | (ref ? OVERFLOW_RECORD : 0);
 
-  // store the value. 
-  if ((int)value.size() >= RecordFile::MAX_VALUE_LENGTH) {
-    // when the string is longer than MAX_VALUE_LENGTH, truncate it.
-    memcpy(ptr + sizeof(int), value.c_str(), RecordFile::MAX_VALUE_LENGTH -1);
-    *(ptr + sizeof(int) + RecordFile::MAX_VALUE_LENGTH - 1) = 0;
+  // store the key, the id of a moved record or its stub,
+  // the reference to the overflow pages and the value
+  if (pax) {
+    memcpy(page + sizeof(RecordPageHeader) + n * sizeof(int), &key, sizeof(int));
   } else {
-    strcpy(ptr + sizeof(int), value.c_str());
+    memcpy(ptr, &key, sizeof(int));
+    ptr += sizeof(int);
+  }
+  if (link) {
+    memcpy(ptr, link, sizeof(RecordId));
+    ptr += sizeof(RecordId);
+  }
+  if (ref) {
+    memcpy(ptr, ref, sizeof(OverflowRef));
+    ptr += sizeof(OverflowRef);
+  }
+  memcpy(ptr, value, length);
+}
+
+static void deleteSlot(char* page, int n)
+{
+  RecordPageHeader* header = (RecordPageHeader*) page;
+  RecordSlot* slot = (RecordSlot*) getSlots(page) + n;
+
+  // the slot goes to the front of the free list
+  if (slot->length & FORWARD_RECORD) header->stubCount--;
+  slot->offset = DEAD_RECORD;
+  slot->length = (header->freeSlot < 0) ? NO_FREE_SLOT : header->freeSlot;
+  header->freeSlot = n;
+  header->liveCount--;
+}
+
+static void compactPage(char* page, int pageSize)
+{
+  RecordPageHeader* header = (RecordPageHeader*) page;
+  RecordSlot* slots = (RecordSlot*) getSlots(page);
+  char copy[PageFile::MAX_PAGE_SIZE];
+  int size;
+
+  // the live records are copied back from the end of the page
+  memcpy(copy, page, pageSize);
+  header->dataStart = pageSize;
+  for (int i = 0; i < header->count; i++) {
+    if (slots[i].offset == DEAD_RECORD) continue;
+    size = slots[i].length & RECORD_LENGTH;
+    header->dataStart -= size;
+    memcpy(page + header->dataStart, copy + slots[i].offset, size);
+    slots[i].offset = header->dataStart;
   }
 }
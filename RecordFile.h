@@ -2,8 +2,12 @@
 #ifndef RECORDFILE_H
 #define RECORDFILE_H
 
+#include <set>
 #include <string>
+#include <vector>
 #include "PageFile.h"
+#include "PageHandle.h"
+#include "ZoneMap.h"
 
 /**
  * The data structure for pointing to a particular record in a RecordFile.
@@ -18,10 +22,6 @@ typedef struct {
 // helper functions for RecordId
 // 
 
-// RecordId iterators
-RecordId& operator++ (RecordId& rid);
-RecordId  operator++ (RecordId& rid, int);
-
 // RecordId comparators
 bool operator> (const RecordId& r1, const RecordId& r2);
 bool operator< (const RecordId& r1, const RecordId& r2);
@@ -31,30 +31,118 @@ bool operator== (const RecordId& r1, const RecordId& r2);
 bool operator!= (const RecordId& r1, const RecordId& r2);
 
 /**
- * read/write a record to a file
+ * The cursor of a sequential scan of a RecordFile.
+ * The page of the record the cursor points to stays pinned in the cursor,
+ * so the records of a page are read with one page fetch.
+ */
+typedef struct {
+  RecordId   rid;   // the next record to read
+  RecordId   last;  // the last record read
+  PageHandle page;  // the last page read (empty until a page is pinned)
+  PageId     pid;   // the id of the page in page
+  int        zone;  // # record pages before rid.pid
+  std::vector<int> keys;  // the keys gathered from a row page by readKeys()
+} ScanCursor;
+
+/**
+ * read/write a record to a file.
+ * the records are stored in slotted pages: a page starts with the number
+ * of its slots and a directory of (offset, length) pairs, and the records
+ * are packed from the end of the page towards the directory. so a record
+ * takes only as much space as its value, and the sid of a record stays
+ * the index of its slot.
+ *
+ * a value that would take more than a quarter of a page is stored in a
+ * chain of overflow pages, and its record keeps only a prefix of it,
+ * so that long values do not crowd the record pages. scans skip the
+ * overflow pages, and readPrefix() reads a record without its chain.
+ *
+ * a file may be created with the PAX layout, where a page keeps the keys
+ * of its records in an array of ints ahead of the slot directory and the
+ * slots hold only the values. a scan that needs only the keys then reads
+ * them with readKeys() from a dense array instead of from every record.
+ *
+ * the bounds of the keys and values of every record page are kept in a
+ * ZoneMap next to the file, so that a scan can skip the pages that
+ * cannot match its conditions without reading them. the zone map is
+ * created with the file; a file without a complete zone map is read
+ * without it.
+ *
+ * page 0 of the file is a header that links to the first and the last
+ * record page and keeps the statistics of the file, so that opening the
+ * file reads no other page and # records is known without a scan.
+ *
+ * a deleted record leaves its slot behind as a tombstone, so that the
+ * other records keep their ids. records are only appended to the last
+ * page, so only the slots of that page are reused; the tombstones of the
+ * other pages stay until compact() moves the records of sparse pages to
+ * the last page and frees the pages they leave.
+ *
+ * update() rewrites a record in its page when the new value fits there.
+ * otherwise the record moves to the last page and leaves a stub with its
+ * new id in its slot, so that it keeps its id and the indexes of the file
+ * need no change. scans skip the stubs and return a moved record with the
+ * id of its stub. compact() puts a moved record back in the place of its
+ * stub when the page of the stub is emptied.
  */
+
+struct OverflowRef;
+
 class RecordFile {
  public:
 
-  // maximum length of the value field
-  static const int MAX_VALUE_LENGTH = 100;  
+  // the layouts of a record page
+  static const int ROW_LAYOUT = 0;  // a record is the key followed by the value
+  static const int PAX_LAYOUT = 1;  // the keys are stored apart from the values
 
-  // number of record slots per page
-  static const int RECORDS_PER_PAGE = (PageFile::PAGE_SIZE - sizeof(int))/ (sizeof(int) + MAX_VALUE_LENGTH);  
-    // Note that we subtract sizeof(int) from PAGE_SIZE because the first
-    // four bytes in the page is used to store # records in the page.
+  /**
+   * the function called by compact() or update() for a record they moved
+   * to a new id.
+   * @param arg[IN] the argument given to compact() or update()
+   * @param key[IN] the record key
+   * @param from[IN] the old location of the record
+   * @param to[IN] the new location of the record
+   * @return error code. compaction stops on an error
+   */
+  typedef RC (*MoveCallback)(void* arg, int key, const RecordId& from, const RecordId& to);
+
+  /**
+   * the statistics of the file, kept in its header page so that they are
+   * read without a scan. the key bounds only widen until the file is
+   * emptied, as deleted records leave them as they are
+   */
+  struct Stats {
+    int       recordCount;  // # records
+    int       pageCount;    // # record pages, without overflow pages
+    int       minKey;       // no key is smaller (INT_MAX if empty)
+    int       maxKey;       // no key is larger (INT_MIN if empty)
+    long long valueBytes;   // # bytes of all values
+
+    /**
+     * @return the average length of a value (0 if there is no record)
+     */
+    int avgValueLength() const { return recordCount ? (int) (valueBytes / recordCount) : 0; }
+  };
 
   RecordFile();
   RecordFile(const std::string& filename, char mode);
   
   /**
-   * open a file in read or write mode.
+   * open a file in read, write, memory-mapped read or direct read mode.
    * when opened in 'w' mode, if the file does not exist, it is created.
+   * in 'm' mode, records are read straight from the mapped file.
+   * in 'd' mode, pages bypass the kernel page cache.
+   * in 's' mode, the file is read ahead for a sequential scan.
    * @param filename[IN] the name of the file to open
-   * @param mode[IN] 'r' for read, 'w' for write
+   * @param mode[IN] 'r' for read, 'w' for write, 'm' for memory-mapped read,
+   *                 'd' for direct read, 's' for sequential scan
+   * @param pageSize[IN] the page size of the file if it is created
+   * @param newLayout[IN] the layout of the pages if the file is empty.
+   *                      otherwise new pages get the layout of the last page
    * @return error code. 0 if no error
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, int pageSize = PageFile::DEFAULT_PAGE_SIZE,
+          int newLayout = ROW_LAYOUT);
 
   /**
    * close the file.
@@ -71,6 +159,73 @@ class RecordFile {
    */
   RC read(const RecordId& rid, int& key, std::string& value) const;
 
+  /**
+   * read a record without reading the overflow pages of its value.
+   * @param rid[IN] the id of the record to read
+   * @param key[OUT] the record key
+   * @param prefix[OUT] the value, or a prefix of it if it is long
+   * @param complete[OUT] true if prefix is the whole value
+   * @return error code. 0 if no error
+   */
+  RC readPrefix(const RecordId& rid, int& key, std::string& prefix, bool& complete) const;
+
+  /**
+   * set the cursor to the first record of the file.
+   * @param cursor[OUT] the cursor of the scan
+   */
+  void startScan(ScanCursor& cursor) const;
+
+  /**
+   * read the record at the cursor in place and move the cursor forward
+   * to the next record. the value is not copied: it points into the page
+   * pinned by the cursor and stays valid until the cursor moves to
+   * another page, is released, or the file is closed. like readPrefix(),
+   * only the prefix of a long value is returned. deleted records are
+   * passed over, and the id of the record read is left in cursor.last.
+   * @param cursor[IN/OUT] the cursor pointing to a record before endRid()
+   * @param key[OUT] the record key
+   * @param value[OUT] the value, or a prefix of it if it is long
+   * @param length[OUT] # bytes of value
+   * @param complete[OUT] true if value is the whole value
+   * @return error code. RC_END_OF_FILE if only deleted records are left
+   */
+  RC readForward(ScanCursor& cursor, int& key, const char*& value, int& length, bool& complete) const;
+
+  /**
+   * read the keys of the records from the cursor to the end of its page
+   * and move the cursor to the next page. the keys of a PAX page are
+   * read in place; they stay valid like the values of readForward().
+   * @param cursor[IN/OUT] the cursor pointing to a record before endRid()
+   * @param keys[OUT] the array of keys
+   * @param count[OUT] # keys in the array
+   * @return error code. RC_END_OF_FILE if only deleted records are left
+   */
+  RC readKeys(ScanCursor& cursor, const int*& keys, int& count) const;
+
+  /**
+   * read the zone of the page the cursor points to.
+   * @param cursor[IN] the cursor pointing to the first record of a page
+   * @param zone[OUT] the bounds of the records in the page
+   * @return error code. RC_NO_SUCH_RECORD if the file has no zone map
+   */
+  RC readZone(const ScanCursor& cursor, ZoneMap::Zone& zone) const;
+
+  /**
+   * move the cursor to the next record page without reading the page.
+   * @param cursor[IN/OUT] the cursor pointing to the first record of a page
+   * @return error code. 0 if no error
+   */
+  RC skipPage(ScanCursor& cursor) const;
+
+  /**
+   * start reading the pages of the records into memory without waiting
+   * for them, so that the following read() calls find them cached.
+   * @param rids[IN] the ids of the records that will be read
+   * @param count[IN] the number of records
+   * @return error code. 0 if no error
+   */
+  RC prefetch(const RecordId* rids, int count) const;
+
   /**
    * append a new record at the end of the file.
    * note that RecordFile does not have write() function.
@@ -83,14 +238,255 @@ class RecordFile {
   RC append(int key, const std::string& value, RecordId& rid);
 
   /**
-   * note the +1 part. The rid of the last record is endRid()-1.
+   * append a new record at the end of the file without writing the page
+   * for every record. the last page is kept in memory and written only
+   * when it is full, so a load writes each page once. the records
+   * appended in bulk can be read after flushBulk(), append() or close().
+   * @param key[IN] the record key
+   * @param value[IN] the record value
+   * @param rid[OUT] the location of the stored record
+   * @return error code. 0 if no error
+   */
+  RC appendBulk(int key, const std::string& value, RecordId& rid);
+
+  /**
+   * write the page kept in memory by appendBulk() to the file.
+   * @return error code. 0 if no error
+   */
+  RC flushBulk();
+
+  /**
+   * delete a record. its slot is kept as a tombstone until it is reused
+   * by a record appended to the page or the page is compacted, and the
+   * overflow pages of a long value are freed.
+   * @param rid[IN] the id of the record to delete
+   * @return error code. RC_INVALID_RID if there is no such record
+   */
+  RC remove(const RecordId& rid);
+
+  /**
+   * replace the value of a record. the record is rewritten in place if
+   * the new value fits in its page, or moved to the last page behind a
+   * stub that keeps its id. only when not even the stub fits in the page
+   * does the record get a new id, which is passed to moved.
+   * @param rid[IN] the id of the record to update
+   * @param value[IN] the new value
+   * @param moved[IN] the function called if the record gets a new id, or NULL
+   * @param arg[IN] the argument passed to moved
+   * @return error code. RC_INVALID_RID if there is no such record
+   */
+  RC update(const RecordId& rid, const std::string& value, MoveCallback moved = NULL, void* arg = NULL);
+
+  /**
+   * reclaim the space of deleted records. the records of the pages that
+   * are less than half full are moved to the last page, and the emptied
+   * pages are unlinked and freed. moved is called for every moved record,
+   * so that the indexes of the file can follow it.
+   * @param moved[IN] the function called for a moved record, or NULL
+   * @param arg[IN] the argument passed to moved
+   * @return error code. 0 if no error
+   */
+  RC compact(MoveCallback moved, void* arg);
+
+  /**
+   * @return # deleted records whose slots are not reused yet
+   */
+  int getDeadCount() const { return deadCount; }
+
+  /**
+   * @return the statistics of the file
+   */
+  const Stats& getStats() const { return stats; }
+
+  /**
+   * note the +1 part. The rid of the last slot is endRid()-1.
+   * a scan is over when its cursor reaches endRid().
    * @return (last record id + 1) of the RecordFile
    */
   const RecordId& endRid() const;
 
+  /**
+   * move the record id to the next record slot of the file.
+   * the number of slots of the page is read from the page.
+   * @param rid[IN/OUT] the record id to advance
+   * @return error code. 0 if no error
+   */
+  RC nextRid(RecordId& rid) const;
+
+  /**
+   * @return the max length of a value stored in its record page.
+   *         longer values are stored in overflow pages
+   */
+  int getMaxInlineLength() const;
+
  private:
   PageFile pf;     // the PageFile used to store the records
-  RecordId erid;   // the last record id of the file + 1
+  RecordId erid;   // the last record id of the file + 1.
+                   // erid.sid is the number of slots of the last page
+  PageId   first;  // the first record page (-1 if there is none)
+  int      deadCount;  // # deleted records whose slots are not reused yet
+  Stats    stats;      // the statistics kept in the header
+  bool     headerDirty;  // true if the header page is not written yet
+  int      layout; // the layout of new pages
+  ZoneMap  zones;  // the bounds of the records of each page
+  std::vector<char> bulkPage;  // the last page while appending in bulk
+  bool     bulkPending;        // true if bulkPage is not written yet
+  bool     compacting;         // true while compact() moves records
+
+  /**
+   * read the first and the last record page and the statistics from
+   * the header page.
+   * @return error code. 0 if no error
+   */
+  RC readHeader();
+
+  /**
+   * write the header page if it has changed.
+   * @return error code. 0 if no error
+   */
+  RC writeHeader();
+
+  /**
+   * add a record to the last page, or to a new page if it does not fit.
+   * the last page is written to the file when a new page is started.
+   * @param page[IN/OUT] the content of the last page (if erid.sid > 0)
+   * @param key[IN] the record key
+   * @param value[IN] the record value
+   * @param rid[OUT] the location of the stored record
+   * @return error code. 0 if no error
+   */
+  RC appendToPage(char* page, int key, const std::string& value, RecordId& rid);
+
+  /**
+   * make room for a record in the last page. if the record does not fit
+   * even once the page is compacted, the page is written and a new last
+   * page is started.
+   * @param page[IN/OUT] the content of the last page (if erid.pid >= 0)
+   * @param length[IN] # bytes of the value stored in the page
+   * @param overflow[IN] true if the rest of the value is in overflow pages
+   * @param link[IN] true if the record is moved and keeps the id of its stub
+   * @return error code. 0 if no error
+   */
+  RC reservePage(char* page, int length, bool overflow, bool link);
+
+  /**
+   * add a record to the last page, for which reservePage() made room.
+   * @param page[IN/OUT] the content of the last page
+   * @param key[IN] the record key
+   * @param value[IN] the value, or the prefix of a long value
+   * @param length[IN] # bytes of value
+   * @param ref[IN] the overflow pages of a long value, or NULL
+   * @param home[IN] the stub of a moved record, or NULL
+   * @param rid[OUT] the location of the stored record
+   * @return error code. 0 if no error
+   */
+  RC addRecord(char* page, int key, const char* value, int length,
+               const OverflowRef* ref, const RecordId* home, RecordId& rid);
+
+  /**
+   * add a record to the last page on the disk, like append().
+   * the arguments are those of addRecord()
+   * @return error code. 0 if no error
+   */
+  RC appendRecord(int key, const char* value, int length, const OverflowRef* ref,
+                  const RecordId* home, RecordId& rid);
+
+  /**
+   * update a record that was moved by an earlier update.
+   * @param stub[IN] the id of the record, where its stub is
+   * @param target[IN] the place of the record
+   * @param value[IN] the new value
+   * @return error code. 0 if no error
+   */
+  RC updateMoved(const RecordId& stub, const RecordId& target, const std::string& value);
+
+  /**
+   * point the stub of a moved record to its new place.
+   * @param stub[IN] the stub
+   * @param key[IN] the record key
+   * @param to[IN] the new place of the record
+   * @return error code. 0 if no error
+   */
+  RC rewriteStub(const RecordId& stub, int key, const RecordId& to);
+
+  /**
+   * delete the record in a page on the disk, leaving deadCount alone.
+   * @param rid[IN] the record
+   * @param freeValue[IN] true if the overflow pages of a long value are freed
+   * @return error code. 0 if no error
+   */
+  RC dropRecord(const RecordId& rid, bool freeValue);
+
+  /**
+   * move a record of a sparse page to the last page kept by compact().
+   * a stub is replaced by the record it points to.
+   * @param page[IN] the sparse page
+   * @param from[IN] the record
+   * @param moved[IN] the function called for the new id of the record
+   * @param arg[IN] the argument passed to moved
+   * @param kept[IN] the pages compact() walked and kept so far
+   * @return error code. 0 if no error
+   */
+  RC moveRecord(const char* page, const RecordId& from, MoveCallback moved, void* arg,
+                const std::set<PageId>& kept);
+
+  /**
+   * find the record a stub points to.
+   * @param rid[IN] the id of a live record
+   * @param page[IN/OUT] the pinned page of rid, replaced by the page of
+   *                     the record if rid is a stub
+   * @param sid[OUT] the slot of the record in page
+   * @return error code. 0 if no error
+   */
+  RC followStub(const RecordId& rid, PageHandle& page, int& sid) const;
+
+  /**
+   * pin the page of the record at the cursor if it is not pinned yet.
+   * @param cursor[IN/OUT] the cursor pointing to a record before endRid()
+   * @return error code. 0 if no error
+   */
+  RC pinScanPage(ScanCursor& cursor) const;
+
+  /**
+   * move the cursor past deleted records to the next live record,
+   * pinning its page.
+   * @param cursor[IN/OUT] the cursor of the scan
+   * @return error code. RC_END_OF_FILE if no live record is left
+   */
+  RC seekRecord(ScanCursor& cursor) const;
+
+  /**
+   * open the zone map of the file, unless it does not cover
+   * all record pages of the file.
+   * @param filename[IN] the name of the RecordFile
+   * @param mode[IN] the mode the RecordFile is opened in
+   */
+  void openZoneMap(const std::string& filename, char mode);
+
+  /**
+   * write a long value to a chain of new overflow pages.
+   * @param value[IN] the value to write
+   * @param owner[IN] the record page of the value
+   * @param first[OUT] the first page of the chain
+   * @return error code. 0 if no error
+   */
+  RC writeOverflow(const std::string& value, PageId owner, PageId& first);
+
+  /**
+   * read a long value from its chain of overflow pages.
+   * @param first[IN] the first page of the chain
+   * @param length[IN] the length of the value
+   * @param value[OUT] the value
+   * @return error code. 0 if no error
+   */
+  RC readOverflow(PageId first, long long length, std::string& value) const;
+
+  /**
+   * free the pages of a chain of overflow pages.
+   * @param head[IN] the first page of the chain
+   * @return error code. 0 if no error
+   */
+  RC freeOverflow(PageId head);
 };
 
 #endif // RECORDFILE_H
@@ -7,9 +7,12 @@
 #include "Bruinbase.h"
 #include "SqlEngine.h"
 #include "BTreeIndex.h"
+#include "BTreeLoader.h"
+#include "WriteAheadLog.h"
 #include <iostream>
 
 #include <climits>
+#include <unistd.h>
 
 using namespace std;
 
@@ -19,6 +22,44 @@ int sqlparse(void);
 
 RC checkConds(SelCond::Comparator comp, int diff, int& count);
 RC printOutput(int attr, int key, string value);
+RC prefetchLeaf(BTLeafNode& leaf, int eid, const RecordFile& rf);
+
+// compare a value that is not null-terminated with a string like strcmp()
+static int compareValue(const char* value, int length, const char* s);
+
+// report why the table file could not be opened with the error code rc
+static void printOpenError(const string& table, RC rc);
+
+// check the conditions on the key
+static bool keyMatches(int key, const vector<SelCond>& cond);
+
+// estimate # tuples whose keys are between min and max from the
+// statistics of the table, taking the keys as spread evenly
+static long long estimateCount(const RecordFile::Stats& stats, int min, int max);
+
+// skip the pages of a table scan whose zones do not meet the conditions
+static RC skipZones(const RecordFile& rf, ScanCursor& cursor, const vector<SelCond>& cond);
+
+// point the index entry of a record moved by RecordFile::compact()
+// or RecordFile::update() to its new location
+static RC moveIndexEntry(void* index, int key, const RecordId& from, const RecordId& to);
+
+// build an index that an interrupted load left stale again from its table
+static RC rebuildIndex(BTreeIndex& treeIndex, const RecordFile& rf, int fillPercent);
+
+// collect the tuples that meet the conditions with a table scan
+static RC scanTuples(const RecordFile& rf, const vector<SelCond>& cond,
+                     vector<int>& keys, vector<RecordId>& rids);
+
+// collect the tuples that meet the conditions through the index,
+// following its leaves over the key range of the conditions
+static RC lookupTuples(BTreeIndex& treeIndex, const RecordFile& rf, const vector<SelCond>& cond,
+                       vector<int>& keys, vector<RecordId>& rids);
+
+char SqlEngine::readMode = 'r';
+int SqlEngine::pageSize = PageFile::DEFAULT_PAGE_SIZE;
+int SqlEngine::tableLayout = RecordFile::ROW_LAYOUT;
+int SqlEngine::indexFill = BTreeLoader::DEFAULT_FILL_PERCENT;
 
 
 RC SqlEngine::run(FILE* commandline)
@@ -37,10 +78,16 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
 {
   RecordFile rf;   // RecordFile containing the table
   RecordId   rid;  // record cursor for table scanning
+  ScanCursor cursor;  // the pinned page of a table scan
 
   RC     rc;
   int    key;     
   string value;
+  const char* data;  // the value in the page of a table scan
+  int    length;
+  const int* keys;   // the keys of a page in a key-only table scan
+  int    keyCount;
+  bool   complete;
   int    count;
   int    diff;
 
@@ -107,27 +154,81 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
   else if (!hasRange && !needRead) // count(*) from whole table
     doIndexSel = 1;
 
+  /*  *  *  *  *  *  *  *  *  *  *  *  *
+    PLAN WITH THE TABLE STATISTICS
+  *  *  *  *  *  *  *  *  *  *  *  *  */
+  // count(*) from the whole table is kept in the table header. a range
+  // with more tuples than the table has pages is read faster by a scan
+  // than by fetching its tuples through the index one by one
+  if (doIndexSel && rf.open(table + ".tbl", readMode) == 0) {
+    const RecordFile::Stats& stats = rf.getStats();
+    if (attr == 4 && cond.empty()) {
+      fprintf(stdout, "%d\n", stats.recordCount);
+      rf.close();
+      return 0;
+    }
+    if (needRead && estimateCount(stats, (eql != -1) ? eql : min, (eql != -1) ? eql : max) > stats.pageCount)
+      doIndexSel = 0;
+    rf.close();
+  }
+
   /*  *  *  *  *  *  *  *  *  *  *  *
     REGULAR SEARCH OF INDEX SEARCH
   *  *  *  *  *  *  *  *  *  *  *  */
   BTreeIndex treeIndex;
-  if (!doIndexSel || ((rc = treeIndex.open(table + ".idx", 'r')) < 0)) 
+
+  // an index that an interrupted load left stale is passed over until
+  // the next change of the table builds it again
+  if (doIndexSel && (treeIndex.open(table + ".idx", readMode) < 0 ||
+                     treeIndex.readInfo() < 0 || treeIndex.isStale()))
+    doIndexSel = 0;
+
+  if (!doIndexSel)
   {
     // IF NO RANGE/EQ OR INDEX FILE DNE = DO REGULAR SELECT
-    // scan the table file from the beginning
-    if ((rc = rf.open(table + ".tbl", 'r')) < 0) {
-      fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+    // scan the table file from the beginning, reading the pages ahead
+    if ((rc = rf.open(table + ".tbl", (readMode == 'r') ? 's' : readMode)) < 0) {
+      printOpenError(table, rc);
       return rc;
     }
 
-    rid.pid = rid.sid = 0;
+    rf.startScan(cursor);
     count = 0;
-    while (rid < rf.endRid()) {
-      // read the tuple
-      if ((rc = rf.read(rid, key, value)) < 0) {
+
+    // if the values are not needed, the keys are read a page at a time
+    while (!needRead && cursor.rid != rf.endRid()) {
+      if ((rc = skipZones(rf, cursor, cond)) < 0) {
+        fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+        goto exit_select;
+      }
+      if (cursor.rid == rf.endRid()) break;
+
+      if ((rc = rf.readKeys(cursor, keys, keyCount)) == RC_END_OF_FILE) break;
+      if (rc < 0) {
+        fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+        goto exit_select;
+      }
+      for (int j = 0; j < keyCount; j++) {
+        if (!keyMatches(keys[j], cond)) continue;
+        count++;
+        if (attr == 1) fprintf(stdout, "%d\n", keys[j]);
+      }
+    }
+
+    while (cursor.rid != rf.endRid()) {
+      if ((rc = skipZones(rf, cursor, cond)) < 0) {
         fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
         goto exit_select;
       }
+      if (cursor.rid == rf.endRid()) break;
+
+      // read the tuple in place. a long value is read only when it is needed
+      if ((rc = rf.readForward(cursor, key, data, length, complete)) == RC_END_OF_FILE) break;
+      if (rc < 0) {
+        fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+        goto exit_select;
+      }
+      rid = cursor.last;
 
       // check the conditions on the tuple
       for (unsigned i = 0; i < cond.size(); i++) {
@@ -137,7 +238,20 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         	diff = key - atoi(cond[i].value);
         	break;
         case 2:
-        	diff = strcmp(value.c_str(), cond[i].value);
+        	// the prefix of a long value decides unless the condition
+        	// value goes on beyond it
+        	if (!complete && strncmp(data, cond[i].value, length) == 0
+        	    && (int) strlen(cond[i].value) > length) {
+        	  if ((rc = rf.read(rid, key, value)) < 0) {
+        	    fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+        	    goto exit_select;
+        	  }
+        	  data = value.data();
+        	  length = value.size();
+        	  complete = true;
+        	}
+        	diff = compareValue(data, length, cond[i].value);
+        	if (diff == 0 && !complete) diff = 1;
         	break;
         }
 
@@ -168,22 +282,31 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
       // increase matching tuple counter
       count++;
 
+      // the whole value is printed
+      if (!complete && (attr == 2 || attr == 3)) {
+        if ((rc = rf.read(rid, key, value)) < 0) {
+          fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+          goto exit_select;
+        }
+        data = value.data();
+        length = value.size();
+      }
+
       // print the tuple 
       switch (attr) {
       case 1:  // SELECT key
         fprintf(stdout, "%d\n", key);
         break;
       case 2:  // SELECT value
-        fprintf(stdout, "%s\n", value.c_str());
+        fprintf(stdout, "%.*s\n", length, data);
         break;
       case 3:  // SELECT *
-        fprintf(stdout, "%d '%s'\n", key, value.c_str());
+        fprintf(stdout, "%d '%.*s'\n", key, length, data);
         break;
       }
 
-      // move to the next tuple
-      next_tuple:
-      ++rid;
+      // readForward() has moved the cursor to the next tuple
+      next_tuple: ;
     }
   }
   // ELSE INDEX FILE EXISTS && RANGE/EQAULITY QUERY = DO INDEX SEARCH
@@ -191,14 +314,13 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
   {
     // open the table file
     if (needRead) // open table only if we need to read values from it
-      if ((rc = rf.open(table + ".tbl", 'r')) < 0) {
-        fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+      if ((rc = rf.open(table + ".tbl", readMode)) < 0) {
+        printOpenError(table, rc);
         return rc;
       }
 
     count = 0;
 
-    treeIndex.readInfo();
     //fprintf(stdout, "READING@readInfo\n");
 
     //fprintf(stderr, "HERE IS THE TREE HEIGHT: %d\n", treeIndex.getHeight());
@@ -220,7 +342,7 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         //fprintf(stdout, "LOCATING CURSOR EID: %d, PID: %d R.PID: %d\n", cursor.eid, cursor.pid, rid.pid);
 
         BTLeafNode cacheLeaf = treeIndex.getCacheLeaf();
-        if (cacheLeaf.readEntry(cursor.eid, key, rid) < 0)
+        if (cacheLeaf.readEntry(cursor.eid, key, rid) < 0 || key != eql)
           goto no_match;
 
         if ((rc = rf.read(rid, key, value)) < 0)
@@ -246,7 +368,7 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
       else // no need to read from table
       {
         BTLeafNode cacheLeaf = treeIndex.getCacheLeaf();
-        if (cacheLeaf.readEntry(cursor.eid, key, rid) < 0)
+        if (cacheLeaf.readEntry(cursor.eid, key, rid) < 0 || key != eql)
           goto no_match;
         count++;
       }
@@ -262,6 +384,8 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
       }
 
       int curr = min;
+      PageId prefetchedPid = -1;
+      PageId viewedPid = cursor.pid;  // the leaf in the cached leaf
 
       while (curr < max) 
       {
@@ -269,11 +393,25 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
 
         if (needRead) {
           BTLeafNode nextLeaf = treeIndex.getCacheLeaf();
-          if (curr != min) {
-            nextLeaf.read(cursor.pid, treeIndex.getPf());
+          if (cursor.pid != viewedPid) {
+            nextLeaf.view(cursor.pid, treeIndex.getPf());
             treeIndex.updateCacheLeaf(nextLeaf);
+            viewedPid = cursor.pid;
+          }
+
+          // start reading all tuples of a new leaf at once
+          if (cursor.pid != prefetchedPid) {
+            prefetchLeaf(nextLeaf, cursor.eid, rf);
+            prefetchedPid = cursor.pid;
+          }
+          // a leaf may be left with no entry after the cursor by deletes
+          if (treeIndex.readForward(cursor, key, rid) < 0) {
+            cursor.pid = nextLeaf.getNextNodePtr();
+            if (cursor.pid == 0) // the last child node
+              goto no_match;
+            cursor.eid = 0;
+            continue;
           }
-          treeIndex.readForward(cursor, key, rid);
 
           curr = key;
 
@@ -281,8 +419,8 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
           //fprintf(stderr, "We are at pid: %d, eid: %d\n", cursor.pid, cursor.eid);
 
           if ((rc = rf.read(rid, key, value)) < 0) {
-            fprintf(stdout, "error with r.pid: %d, r.eid: %d, key: %d\n", rid.pid, rid.sid, key);
-            fprintf(stderr, "We are at pid: %d, eid: %d\n", cursor.pid, cursor.eid);
+            fprintf(stdout, "error with r.pid: %lld, r.eid: %d, key: %d\n", rid.pid, rid.sid, key);
+            fprintf(stderr, "We are at pid: %lld, eid: %d\n", cursor.pid, cursor.eid);
             goto exit_select;
           }
 
@@ -333,11 +471,18 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         else { // no need to read from table
 
           BTLeafNode nextLeaf = treeIndex.getCacheLeaf();
-          if (curr != min) {
-            nextLeaf.read(cursor.pid, treeIndex.getPf());
+          if (cursor.pid != viewedPid) {
+            nextLeaf.view(cursor.pid, treeIndex.getPf());
             treeIndex.updateCacheLeaf(nextLeaf);
+            viewedPid = cursor.pid;
+          }
+          if (treeIndex.readForward(cursor, key, rid) < 0) {
+            cursor.pid = nextLeaf.getNextNodePtr();
+            if (cursor.pid == 0) // the last child node
+              goto no_match;
+            cursor.eid = 0;
+            continue;
           }
-          treeIndex.readForward(cursor, key, rid);
           //cout << "THIS IS THE NEW KEY" << key << endl;
 
           curr = key;
@@ -400,10 +545,157 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
 
   // close the table file and return
   exit_select:
+  cursor.page.release();
   rf.close();
   return rc;
 }
 
+RC SqlEngine::remove(const string& table, const vector<SelCond>& cond)
+{
+  RecordFile rf;
+  BTreeIndex treeIndex;
+  vector<int>      keys;  // the keys of the tuples to delete
+  vector<RecordId> rids;  // the tuples to delete
+  RC     rc;
+  bool   index = false;
+
+  // opening the table for writing would create it
+  if (::access((table + ".tbl").c_str(), F_OK) != 0) {
+    printOpenError(table, RC_FILE_OPEN_FAILED);
+    return RC_FILE_OPEN_FAILED;
+  }
+  if ((rc = rf.open(table + ".tbl", 'w')) < 0) {
+    printOpenError(table, rc);
+    return rc;
+  }
+
+  // the index, if the table has one, loses the entries of the tuples
+  if (::access((table + ".idx").c_str(), F_OK) == 0) {
+    if ((rc = treeIndex.open(table + ".idx", 'w')) < 0) {
+      fprintf(stderr, "Error: while opening the index of table %s\n", table.c_str());
+      rf.close();
+      return rc;
+    }
+    treeIndex.readInfo();
+    index = true;
+
+    // an index that an interrupted load left stale is built again first
+    if (treeIndex.isStale() && (rc = rebuildIndex(treeIndex, rf, indexFill)) < 0) {
+      fprintf(stderr, "Error: while building the index of table %s\n", table.c_str());
+      goto exit_delete;
+    }
+  }
+
+  // collect the tuples that meet the conditions
+  if ((rc = scanTuples(rf, cond, keys, rids)) < 0) {
+    fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+    goto exit_delete;
+  }
+
+  // delete the tuples and their index entries
+  for (unsigned i = 0; i < rids.size(); i++) {
+    if ((rc = rf.remove(rids[i])) < 0 ||
+        (index && (rc = treeIndex.remove(keys[i], rids[i])) < 0)) {
+      fprintf(stderr, "Error: while deleting a tuple from table %s\n", table.c_str());
+      goto exit_delete;
+    }
+
+    // commit the deleted tuples in groups like the loaded ones
+    if (WriteAheadLog::commitDue() &&
+        ((rc = rf.flushBulk()) < 0 || (rc = WriteAheadLog::commit()) < 0)) {
+      fprintf(stderr, "Error: while committing the deleted tuples\n");
+      goto exit_delete;
+    }
+  }
+
+  // once a quarter of the slots of the table are deleted, the sparse pages
+  // are compacted and the index follows the moved tuples. the slots are
+  // counted from the statistics, since the scan skips the pages that the
+  // zone map rules out
+  if (!rids.empty() && rf.getDeadCount() * 3 >= rf.getStats().recordCount) {
+    if ((rc = rf.compact(index ? moveIndexEntry : NULL, &treeIndex)) < 0) {
+      fprintf(stderr, "Error: while compacting table %s\n", table.c_str());
+      goto exit_delete;
+    }
+  }
+  rc = 0;
+
+  exit_delete:
+  if (index && treeIndex.close() < 0 && rc == 0) rc = RC_FILE_WRITE_FAILED;
+  if (rf.close() < 0 && rc == 0) rc = RC_FILE_WRITE_FAILED;
+  return rc;
+}
+
+RC SqlEngine::update(const string& table, const string& value, const vector<SelCond>& cond)
+{
+  RecordFile rf;
+  BTreeIndex treeIndex;
+  vector<int>      keys;  // the keys of the tuples to update
+  vector<RecordId> rids;  // the tuples to update
+  RC     rc;
+  bool   index = false;
+  bool   keyRange = false;
+
+  // opening the table for writing would create it
+  if (::access((table + ".tbl").c_str(), F_OK) != 0) {
+    printOpenError(table, RC_FILE_OPEN_FAILED);
+    return RC_FILE_OPEN_FAILED;
+  }
+  if ((rc = rf.open(table + ".tbl", 'w')) < 0) {
+    printOpenError(table, rc);
+    return rc;
+  }
+
+  // the index follows the tuples that have to move
+  if (::access((table + ".idx").c_str(), F_OK) == 0) {
+    if ((rc = treeIndex.open(table + ".idx", 'w')) < 0) {
+      fprintf(stderr, "Error: while opening the index of table %s\n", table.c_str());
+      rf.close();
+      return rc;
+    }
+    treeIndex.readInfo();
+    index = true;
+
+    // an index that an interrupted load left stale is built again first
+    if (treeIndex.isStale() && (rc = rebuildIndex(treeIndex, rf, indexFill)) < 0) {
+      fprintf(stderr, "Error: while building the index of table %s\n", table.c_str());
+      goto exit_update;
+    }
+  }
+
+  // the tuples are looked up in the index when the key is bounded
+  for (unsigned i = 0; i < cond.size(); i++) {
+    if (cond[i].attr == 1 && cond[i].comp != SelCond::NE) keyRange = true;
+  }
+  rc = (index && keyRange) ? lookupTuples(treeIndex, rf, cond, keys, rids)
+                           : scanTuples(rf, cond, keys, rids);
+  if (rc < 0) {
+    fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+    goto exit_update;
+  }
+
+  // a tuple keeps its id unless it moves without a stub
+  for (unsigned i = 0; i < rids.size(); i++) {
+    if ((rc = rf.update(rids[i], value, index ? moveIndexEntry : NULL, &treeIndex)) < 0) {
+      fprintf(stderr, "Error: while updating a tuple of table %s\n", table.c_str());
+      goto exit_update;
+    }
+
+    // commit the updated tuples in groups like the loaded ones
+    if (WriteAheadLog::commitDue() &&
+        ((rc = rf.flushBulk()) < 0 || (rc = WriteAheadLog::commit()) < 0)) {
+      fprintf(stderr, "Error: while committing the updated tuples\n");
+      goto exit_update;
+    }
+  }
+  rc = 0;
+
+  exit_update:
+  if (index && treeIndex.close() < 0 && rc == 0) rc = RC_FILE_WRITE_FAILED;
+  if (rf.close() < 0 && rc == 0) rc = RC_FILE_WRITE_FAILED;
+  return rc;
+}
+
 RC SqlEngine::load(const string& table, const string& loadfile, bool index)
 {
 
@@ -411,7 +703,7 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
   RecordId   rid;
   RC rc; 
 
-  if ((rc = rf.open(table + ".tbl", 'w')) < 0) {
+  if ((rc = rf.open(table + ".tbl", 'w', pageSize, tableLayout)) < 0) {
     fprintf(stderr, "Error with creating/opening table %s \n", table.c_str());
     return rc;
   }
@@ -426,14 +718,21 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
 
 
   BTreeIndex treeIndex;
+  BTreeLoader loader(treeIndex, indexFill);
   if (index)
   {
-    if (treeIndex.open(table + ".idx", 'w') < 0) {
+    if (treeIndex.open(table + ".idx", 'w', pageSize) < 0) {
       fprintf(stderr, "Error with creating/opening index %s \n", table.c_str());
       return rc;
     }
 
     treeIndex.readInfo();
+
+    // the index is stale until it is built from the keys of all rows
+    if ((rc = loader.start(rf)) < 0) {
+      fprintf(stderr, "Error building index %s\n", table.c_str());
+      return rc;
+    }
   }
 
   string fileline;
@@ -448,7 +747,7 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
       return -1;
     }
 
-    if (rf.append(key, value, rid) < 0)
+    if (rf.appendBulk(key, value, rid) < 0)
     {
       fprintf(stderr, "Error appending a tuple\n");
       return -1;
@@ -456,10 +755,19 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
 
     //fprintf(stdout, "R.PID: %d\n", rid.pid);
 
-    if (index)
+    if (index && (rc = loader.add(key, rid)) < 0)
+    {
+      fprintf(stderr, "Error adding a key to index %s\n", table.c_str());
+      return rc;
+    }
+
+    // commit the loaded rows together once their pages fill a good part
+    // of the buffer pool, which cannot evict them before they are logged
+    if (WriteAheadLog::commitDue() &&
+        ((rc = rf.flushBulk()) < 0 || (rc = WriteAheadLog::commit()) < 0))
     {
-      //BTreeIndex treeIndex;
-      treeIndex.insert(key, rid);
+      fprintf(stderr, "Error committing the loaded tuples\n");
+      return rc;
     }
 
   }
@@ -468,6 +776,25 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
 
   loaded_file.close();
 
+  // build the index in one pass over the sorted keys, and commit it with
+  // the last rows before the files are closed, since the files are
+  // written back one after the other
+  if (index && ((rc = rf.flushBulk()) < 0 || (rc = loader.finish()) < 0 ||
+                (rc = WriteAheadLog::commit()) < 0)) {
+    fprintf(stderr, "Error building index %s\n", table.c_str());
+    return rc;
+  }
+
+  // write back the loaded pages, which were kept in the buffer pool
+  if (index && (rc = treeIndex.close()) < 0) {
+    fprintf(stderr, "Error writing index %s\n", table.c_str());
+    return rc;
+  }
+  if ((rc = rf.close()) < 0) {
+    fprintf(stderr, "Error writing table %s\n", table.c_str());
+    return rc;
+  }
+
   return 0;
 }
 
@@ -557,3 +884,277 @@ RC printOutput (int attr, int key, string value) {
 
   return 0;
 }
+
+RC prefetchLeaf(BTLeafNode& leaf, int eid, const RecordFile& rf)
+{
+  vector<RecordId> rids;
+  RecordId rid;
+  int      key;
+
+  // collect the record ids from the entry eid to the end of the leaf
+  for (; leaf.readEntry(eid, key, rid) == 0; eid++) {
+    rids.push_back(rid);
+  }
+  if (rids.empty()) return 0;
+
+  return rf.prefetch(&rids[0], rids.size());
+}
+
+static int compareValue(const char* value, int length, const char* s)
+{
+  int slength = strlen(s);
+  int diff = memcmp(value, s, (length < slength) ? length : slength);
+
+  return (diff != 0) ? diff : length - slength;
+}
+
+static void printOpenError(const string& table, RC rc)
+{
+  // a table file that exists may still be unreadable, e.g., if it was
+  // written in an older format
+  if (::access((table + ".tbl").c_str(), F_OK) != 0) {
+    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+  } else {
+    fprintf(stderr, "Error: cannot open table %s (error code %d)\n", table.c_str(), rc);
+  }
+}
+
+static bool keyMatches(int key, const vector<SelCond>& cond)
+{
+  int diff;
+
+  for (unsigned i = 0; i < cond.size(); i++) {
+    if (cond[i].attr != 1) continue;
+
+    diff = key - atoi(cond[i].value);
+    switch (cond[i].comp) {
+    case SelCond::EQ:
+      if (diff != 0) return false;
+      break;
+    case SelCond::NE:
+      if (diff == 0) return false;
+      break;
+    case SelCond::GT:
+      if (diff <= 0) return false;
+      break;
+    case SelCond::LT:
+      if (diff >= 0) return false;
+      break;
+    case SelCond::GE:
+      if (diff < 0) return false;
+      break;
+    case SelCond::LE:
+      if (diff > 0) return false;
+      break;
+    }
+  }
+  return true;
+}
+
+static long long estimateCount(const RecordFile::Stats& stats, int min, int max)
+{
+  long long lo = (min > stats.minKey) ? min : stats.minKey;
+  long long hi = (max < stats.maxKey) ? max : stats.maxKey;
+
+  if (stats.recordCount == 0 || lo > hi) return 0;
+  return (hi - lo + 1) * stats.recordCount / ((long long) stats.maxKey - stats.minKey + 1);
+}
+
+static RC skipZones(const RecordFile& rf, ScanCursor& cursor, const vector<SelCond>& cond)
+{
+  RC            rc;
+  ZoneMap::Zone zone;
+  char          prefix[ZoneMap::PREFIX_LENGTH];
+  int           key;
+  bool          match;
+
+  // the zone of a page is checked when the scan enters the page
+  while (cursor.rid != rf.endRid() && cursor.rid.sid == 0) {
+    if (rf.readZone(cursor, zone) < 0) return 0;
+
+    match = true;
+    for (unsigned i = 0; i < cond.size() && match; i++) {
+      switch (cond[i].attr) {
+      case 1:
+        key = atoi(cond[i].value);
+        switch (cond[i].comp) {
+        case SelCond::EQ:
+          match = (zone.minKey <= key && key <= zone.maxKey);
+          break;
+        case SelCond::NE:
+          match = (zone.minKey != key || zone.maxKey != key);
+          break;
+        case SelCond::GT:
+          match = (zone.maxKey > key);
+          break;
+        case SelCond::LT:
+          match = (zone.minKey < key);
+          break;
+        case SelCond::GE:
+          match = (zone.maxKey >= key);
+          break;
+        case SelCond::LE:
+          match = (zone.minKey <= key);
+          break;
+        }
+        break;
+      case 2:
+        // a value whose prefix is smaller than that of the condition value
+        // is smaller, and one whose prefix is larger is larger
+        strncpy(prefix, cond[i].value, ZoneMap::PREFIX_LENGTH);
+        switch (cond[i].comp) {
+        case SelCond::EQ:
+          match = (memcmp(zone.minValue, prefix, ZoneMap::PREFIX_LENGTH) <= 0 &&
+                   memcmp(zone.maxValue, prefix, ZoneMap::PREFIX_LENGTH) >= 0);
+          break;
+        case SelCond::NE:
+          break;
+        case SelCond::GT:
+        case SelCond::GE:
+          match = (memcmp(zone.maxValue, prefix, ZoneMap::PREFIX_LENGTH) >= 0);
+          break;
+        case SelCond::LT:
+        case SelCond::LE:
+          match = (memcmp(zone.minValue, prefix, ZoneMap::PREFIX_LENGTH) <= 0);
+          break;
+        }
+        break;
+      }
+    }
+    if (match) return 0;
+
+    if ((rc = rf.skipPage(cursor)) < 0) return rc;
+  }
+  return 0;
+}
+
+static RC moveIndexEntry(void* index, int key, const RecordId& from, const RecordId& to)
+{
+  return ((BTreeIndex*) index)->updateRid(key, from, to);
+}
+
+static RC rebuildIndex(BTreeIndex& treeIndex, const RecordFile& rf, int fillPercent)
+{
+  RC          rc;
+  BTreeLoader loader(treeIndex, fillPercent);
+
+  // the records of the table replace the entries of the index
+  if ((rc = loader.start(rf)) < 0 || (rc = loader.finish()) < 0) return rc;
+
+  return WriteAheadLog::commit();
+}
+
+static RC scanTuples(const RecordFile& rf, const vector<SelCond>& cond,
+                     vector<int>& keys, vector<RecordId>& rids)
+{
+  RC         rc;
+  ScanCursor cursor;
+  string     value;
+  const char* data;
+  int        key, length, diff, count;
+  bool       complete;
+
+  rf.startScan(cursor);
+  while (cursor.rid != rf.endRid()) {
+    if ((rc = skipZones(rf, cursor, cond)) < 0) return rc;
+    if (cursor.rid == rf.endRid()) break;
+
+    if ((rc = rf.readForward(cursor, key, data, length, complete)) == RC_END_OF_FILE) break;
+    if (rc < 0) return rc;
+
+    for (unsigned i = 0; i < cond.size(); i++) {
+      if (cond[i].attr == 1) {
+        diff = key - atoi(cond[i].value);
+      } else {
+        // a long value is compared as a whole
+        if (!complete) {
+          if ((rc = rf.read(cursor.last, key, value)) < 0) return rc;
+          data = value.data();
+          length = value.size();
+          complete = true;
+        }
+        diff = compareValue(data, length, cond[i].value);
+      }
+      if (checkConds(cond[i].comp, diff, count) < 0) goto next_tuple;
+    }
+    keys.push_back(key);
+    rids.push_back(cursor.last);
+
+    next_tuple: ;
+  }
+
+  return 0;
+}
+
+static RC lookupTuples(BTreeIndex& treeIndex, const RecordFile& rf, const vector<SelCond>& cond,
+                       vector<int>& keys, vector<RecordId>& rids)
+{
+  RC          rc;
+  IndexCursor cursor;
+  BTLeafNode  leaf;
+  RecordId    rid;
+  string      value;
+  long long   min = INT_MIN, max = INT_MAX, bound;
+  int         key, count;
+  bool        needRead = false;
+
+  // the key range allowed by the conditions
+  for (unsigned i = 0; i < cond.size(); i++) {
+    if (cond[i].attr != 1) {
+      needRead = true;
+      continue;
+    }
+    bound = atoi(cond[i].value);
+    switch (cond[i].comp) {
+    case SelCond::EQ:
+      if (bound > min) min = bound;
+      if (bound < max) max = bound;
+      break;
+    case SelCond::GT:
+      if (bound + 1 > min) min = bound + 1;
+      break;
+    case SelCond::GE:
+      if (bound > min) min = bound;
+      break;
+    case SelCond::LT:
+      if (bound - 1 < max) max = bound - 1;
+      break;
+    case SelCond::LE:
+      if (bound < max) max = bound;
+      break;
+    case SelCond::NE:
+      break;
+    }
+  }
+  if (min > max) return 0;
+
+  if ((rc = treeIndex.locate((int) min, cursor)) == RC_NO_SUCH_RECORD) return 0;
+  if (rc < 0) return rc;
+
+  // the leaves are followed until a key is past the range.
+  // the last leaf has no next leaf
+  while (cursor.pid > 0) {
+    if ((rc = leaf.view(cursor.pid, treeIndex.getPf())) < 0) return rc;
+    for (; leaf.readEntry(cursor.eid, key, rid) == 0; cursor.eid++) {
+      if (key > max) return 0;
+      if (!keyMatches(key, cond)) continue;
+
+      // the conditions on the value are checked on the whole value
+      if (needRead) {
+        if ((rc = rf.read(rid, key, value)) < 0) return rc;
+        for (unsigned i = 0; i < cond.size(); i++) {
+          if (cond[i].attr == 2 &&
+              checkConds(cond[i].comp, compareValue(value.data(), value.size(), cond[i].value), count) < 0) goto next_entry;
+        }
+      }
+      keys.push_back(key);
+      rids.push_back(rid);
+
+      next_entry: ;
+    }
+    cursor.pid = leaf.getNextNodePtr();
+    cursor.eid = 0;
+  }
+
+  return 0;
+}
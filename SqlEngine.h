@@ -23,8 +23,9 @@ class SqlEngine {
     
   /**
    * takes the user commands from commandline and executes them.
-   * when user issues SELECT or LOAD from commandline, this function
-   * calls SqlEngine::select() or SqlEngine::load() functions.
+   * when user issues SELECT, DELETE, UPDATE or LOAD from commandline, this
+   * function calls SqlEngine::select(), SqlEngine::remove(),
+   * SqlEngine::update() or SqlEngine::load().
    * @param commandline[IN] the input stream to get user commands
    * @return error code. 0 if no error
    */
@@ -42,6 +43,29 @@ class SqlEngine {
    */
   static RC select(int attr, const std::string& table, const std::vector<SelCond>& conds);
 
+  /**
+   * executes a DELETE statement.
+   * all conditions in conds must be ANDed together.
+   * the deleted tuples are removed from the index of the table as well,
+   * and the table is compacted once many of its slots are deleted.
+   * @param table[IN] the table name in the FROM clause
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @return error code. 0 if no error
+   */
+  static RC remove(const std::string& table, const std::vector<SelCond>& conds);
+
+  /**
+   * executes an UPDATE statement that sets the value of the tuples.
+   * all conditions in conds must be ANDed together.
+   * the tuples are found through the index of the table when the
+   * conditions bound the key, and the index follows a tuple that moves.
+   * @param table[IN] the table name in the UPDATE clause
+   * @param value[IN] the new value of the tuples
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @return error code. 0 if no error
+   */
+  static RC update(const std::string& table, const std::string& value, const std::vector<SelCond>& conds);
+
   /**
    * load a table from a load file.
    * @param table[IN] the table name in the LOAD command
@@ -59,6 +83,38 @@ class SqlEngine {
    * @return error code. 0 if no error
    */
   static RC parseLoadLine(const std::string& line, int& key, std::string& value);
+
+  /**
+   * set the mode in which SELECT opens the table and index files.
+   * @param mode[IN] 'r' to read the files through the buffer pool,
+   *                 'm' to read them from memory-mapped files,
+   *                 'd' to read them with direct I/O past the page cache
+   */
+  static void setReadMode(char mode) { readMode = mode; }
+
+  /**
+   * set the page size of the table and index files created by LOAD.
+   * @param size[IN] the page size in bytes
+   */
+  static void setPageSize(int size) { pageSize = size; }
+
+  /**
+   * set the page layout of the table files created by LOAD.
+   * @param layout[IN] RecordFile::ROW_LAYOUT or RecordFile::PAX_LAYOUT
+   */
+  static void setTableLayout(int layout) { tableLayout = layout; }
+
+  /**
+   * set how full LOAD packs the nodes of the indexes it builds.
+   * @param percent[IN] the percent of the capacity of a node to fill
+   */
+  static void setIndexFill(int percent) { indexFill = percent; }
+
+ private:
+  static char readMode;  // the file mode used by SELECT
+  static int  pageSize;  // the page size of the files created by LOAD
+  static int  tableLayout;  // the page layout of the tables created by LOAD
+  static int  indexFill;    // the fill percent of the indexes built by LOAD
 };
 
 #endif /* SQLENGINE_H */
@@ -0,0 +1,436 @@
+#include "Bruinbase.h"
+#include "WriteAheadLog.h"
+#include "BufferPool.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using std::string;
+
+const char* const WriteAheadLog::LOG_NAME = "bruinbase.wal";
+
+int WriteAheadLog::logFd = -1;
+long long WriteAheadLog::baseLsn = 0;
+long long WriteAheadLog::endLsn = 0;
+long long WriteAheadLog::redoLsn = 0;
+long long WriteAheadLog::checkpointLsn = 0;
+bool WriteAheadLog::recovered = false;
+std::map<int, string> WriteAheadLog::files;
+pthread_mutex_t WriteAheadLog::lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t WriteAheadLog::logGrown = PTHREAD_COND_INITIALIZER;
+int WriteAheadLog::crashAfter = 0;
+bool WriteAheadLog::checkpointerStarted = false;
+pthread_t WriteAheadLog::checkpointer;
+
+// the header in the first block of the log
+struct LogHeader {
+  char      magic[12];  // LOG_MAGIC
+  unsigned  checksum;   // checksum of the LSNs
+  long long baseLsn;    // the LSN of the first record in the file
+  long long redoLsn;    // the LSN recovery starts from
+};
+
+static const char LOG_MAGIC[12] = "BRUINLOG";
+
+// the # bytes moved at a time when the log is reclaimed
+static const int COPY_SIZE = 1024 * 1024;
+
+// the table of the CRC-32 that checks the log records
+struct CrcTable {
+  unsigned entry[256];
+
+  CrcTable() {
+    for (unsigned i = 0; i < 256; i++) {
+      unsigned c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      entry[i] = c;
+    }
+  }
+};
+
+static const CrcTable crcTable;
+
+
+RC WriteAheadLog::recover()
+{
+  RC rc = 0;
+  struct stat statbuf;
+
+  pthread_mutex_lock(&lock);
+  if (recovered) {
+    pthread_mutex_unlock(&lock);
+    return 0;
+  }
+
+  // there is nothing to recover if the log does not exist
+  logFd = ::open(LOG_NAME, O_RDWR);
+  if (logFd < 0) {
+    rc = (errno == ENOENT) ? 0 : RC_FILE_OPEN_FAILED;
+  } else if (::fstat(logFd, &statbuf) < 0) {
+    rc = RC_FILE_READ_FAILED;
+  } else if (statbuf.st_size > 0) {
+    // the files have all committed pages now, so the log can be emptied
+    if ((rc = readHeader()) == 0 && (rc = replay(statbuf.st_size)) == 0) {
+      baseLsn = redoLsn = checkpointLsn = endLsn;
+      if ((rc = writeHeader()) == 0 && ::ftruncate(logFd, HEADER_SIZE) < 0) {
+        rc = RC_FILE_WRITE_FAILED;
+      }
+    }
+  }
+
+  recovered = (rc == 0);
+  if (logFd >= 0 && (!recovered || statbuf.st_size == 0)) {
+    ::close(logFd);
+    logFd = -1;
+  }
+
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
+
+RC WriteAheadLog::replay(off_t size)
+{
+  RC rc = 0;
+  std::vector<char> record, page;
+  std::vector<long long> pending;   // the page records of the current group
+  std::map<string, int> fds;        // the files written so far by name
+  long long lsn;
+  Record* r;
+
+  // the records after the last commit record are dropped
+  endLsn = redoLsn;
+  for (lsn = redoLsn; readRecord(lsn, size, record) == 0; lsn += r->length) {
+    r = (Record*) &record[0];
+    if (r->type == PAGE_RECORD) {
+      pending.push_back(lsn);
+      continue;
+    }
+    if (r->type != COMMIT_RECORD) break;
+
+    // the group is committed, so its pages are written to their files
+    for (unsigned i = 0; i < pending.size() && rc == 0; i++) {
+      if ((rc = readRecord(pending[i], size, page)) < 0) break;
+
+      Record* h = (Record*) &page[0];
+      string  name(&page[sizeof(Record)], h->nameLength);
+      char*   image = &page[sizeof(Record) + h->nameLength];
+      int     pageSize = h->length - sizeof(Record) - h->nameLength;
+
+      // the pages of a file that no longer exists are skipped
+      std::map<string, int>::iterator it = fds.find(name);
+      if (it == fds.end()) it = fds.insert(std::make_pair(name, ::open(name.c_str(), O_WRONLY))).first;
+      if (it->second < 0) continue;
+      rc = PageFile::writeBack(it->second, h->pid, pageSize, &image, 1);
+    }
+    pending.clear();
+    if (rc < 0) break;
+    endLsn = lsn + r->length;
+  }
+
+  for (std::map<string, int>::iterator it = fds.begin(); it != fds.end(); ++it) {
+    if (it->second < 0) continue;
+    if (::fdatasync(it->second) < 0 && rc == 0) rc = RC_FILE_WRITE_FAILED;
+    ::close(it->second);
+  }
+
+  return rc;
+}
+
+RC WriteAheadLog::readRecord(long long lsn, off_t size, std::vector<char>& record)
+{
+  Record h;
+  off_t  start = offset(lsn);
+
+  // a torn or incomplete record, or a record left from an earlier use
+  // of the file offset, ends the log
+  if (start + (off_t) sizeof(Record) > size) return RC_INVALID_FILE_FORMAT;
+  if (::pread(logFd, &h, sizeof(h), start) != sizeof(h)) return RC_FILE_READ_FAILED;
+  if (h.lsn != lsn || h.length < (int) sizeof(Record) || start + h.length > size) return RC_INVALID_FILE_FORMAT;
+  if (h.nameLength < 0 || h.nameLength > h.length - (int) sizeof(Record)) return RC_INVALID_FILE_FORMAT;
+
+  record.resize(h.length);
+  if (::pread(logFd, &record[0], h.length, start) != h.length) return RC_FILE_READ_FAILED;
+  if (h.checksum != checksum(&record[sizeof(h.checksum)], h.length - sizeof(h.checksum))) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  return 0;
+}
+
+RC WriteAheadLog::readHeader()
+{
+  LogHeader h;
+
+  if (::pread(logFd, &h, sizeof(h), 0) != sizeof(h)) return RC_INVALID_FILE_FORMAT;
+  if (memcmp(h.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) return RC_INVALID_FILE_FORMAT;
+  if (h.checksum != checksum(&h.baseLsn, sizeof(h) - offsetof(LogHeader, baseLsn))) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  baseLsn = h.baseLsn;
+  redoLsn = h.redoLsn;
+  return 0;
+}
+
+RC WriteAheadLog::writeHeader()
+{
+  LogHeader h;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+  h.baseLsn = baseLsn;
+  h.redoLsn = redoLsn;
+  h.checksum = checksum(&h.baseLsn, sizeof(h) - offsetof(LogHeader, baseLsn));
+  if (::pwrite(logFd, &h, sizeof(h), 0) != sizeof(h)) return RC_FILE_WRITE_FAILED;
+  if (::fdatasync(logFd) < 0) return RC_FILE_WRITE_FAILED;
+
+  return 0;
+}
+
+RC WriteAheadLog::openLog()
+{
+  RC rc = 0;
+  struct stat statbuf;
+
+  logFd = ::open(LOG_NAME, O_RDWR|O_CREAT, 0644);
+  if (logFd < 0) return RC_FILE_OPEN_FAILED;
+
+  // a new log starts with the header only
+  if (::fstat(logFd, &statbuf) < 0) {
+    rc = RC_FILE_OPEN_FAILED;
+  } else if (statbuf.st_size < HEADER_SIZE) {
+    baseLsn = redoLsn = endLsn = checkpointLsn = 0;
+    if ((rc = writeHeader()) == 0 && ::ftruncate(logFd, HEADER_SIZE) < 0) rc = RC_FILE_WRITE_FAILED;
+  } else if ((rc = readHeader()) == 0) {
+    endLsn = checkpointLsn = baseLsn + (statbuf.st_size - HEADER_SIZE);
+  }
+
+  if (rc < 0) {
+    ::close(logFd);
+    logFd = -1;
+  }
+  return rc;
+}
+
+RC WriteAheadLog::addFile(int fd, const string& filename)
+{
+  RC   rc = 0;
+  char path[PATH_MAX];
+
+  pthread_mutex_lock(&lock);
+
+  // the file is logged by its absolute name, so that recover() finds it
+  // regardless of the working directory
+  if (logFd < 0) rc = openLog();
+  if (rc == 0) files[fd] = (::realpath(filename.c_str(), path) != NULL) ? path : filename;
+
+  // the checkpointer runs from the first logged file on
+  if (rc == 0 && !checkpointerStarted) {
+    if (::pthread_create(&checkpointer, NULL, runCheckpointer, NULL) == 0) {
+      ::pthread_detach(checkpointer);
+      checkpointerStarted = true;
+    }
+  }
+
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
+
+RC WriteAheadLog::removeFile(int fd)
+{
+  RC rc = 0;
+
+  pthread_mutex_lock(&lock);
+
+  // when no logged file is open, all committed pages are synced
+  files.erase(fd);
+  if (files.empty() && endLsn > baseLsn) {
+    redoLsn = checkpointLsn = endLsn;
+    rc = reclaim();
+  }
+
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
+
+RC WriteAheadLog::commit()
+{
+  RC rc = 0;
+  std::vector<BufferPool::Frame*> frames;
+  std::vector<long long> lsns;
+  std::vector<char> buffer;
+  Record* r;
+
+  pthread_mutex_lock(&lock);
+
+  // a commit that finds no modified pages has nothing to sync
+  BufferPool::takeUnlogged(frames);
+  if (frames.empty()) {
+    pthread_mutex_unlock(&lock);
+    return 0;
+  }
+  if (logFd < 0) rc = openLog();
+
+  // append a page record for every modified page and a commit record
+  for (unsigned i = 0; i < frames.size() && rc == 0; i++) {
+    std::map<int, string>::iterator it = files.find(frames[i]->fd);
+    if (it == files.end()) {
+      lsns.push_back(-1);
+      continue;
+    }
+
+    size_t pos = buffer.size();
+    int    length = sizeof(Record) + it->second.size() + frames[i]->size;
+    buffer.resize(pos + length);
+    r = (Record*) &buffer[pos];
+    r->type = PAGE_RECORD;
+    r->length = length;
+    r->nameLength = it->second.size();
+    r->lsn = endLsn + pos;
+    r->pid = frames[i]->pid;
+    memcpy(&buffer[pos + sizeof(Record)], it->second.data(), r->nameLength);
+    memcpy(&buffer[pos + sizeof(Record) + r->nameLength], frames[i]->data, frames[i]->size);
+    r->checksum = checksum(&buffer[pos + sizeof(r->checksum)], length - sizeof(r->checksum));
+    lsns.push_back(r->lsn);
+  }
+
+  size_t pos = buffer.size();
+  buffer.resize(pos + sizeof(Record));
+  r = (Record*) &buffer[pos];
+  r->type = COMMIT_RECORD;
+  r->length = sizeof(Record);
+  r->nameLength = 0;
+  r->lsn = endLsn + pos;
+  r->pid = -1;
+  r->checksum = checksum(&buffer[pos + sizeof(r->checksum)], sizeof(Record) - sizeof(r->checksum));
+
+  // one write and one sync for the whole group
+  if (rc == 0 && ::pwrite(logFd, &buffer[0], buffer.size(), offset(endLsn)) != (ssize_t) buffer.size()) {
+    rc = RC_FILE_WRITE_FAILED;
+  }
+  if (rc == 0 && ::fdatasync(logFd) < 0) rc = RC_FILE_WRITE_FAILED;
+  if (rc == 0) endLsn += buffer.size();
+
+  // the pages may be written back to their files from now on, and the
+  // log has to be kept from their records on until they are.
+  // if the commit failed, they stay unlogged
+  for (unsigned i = 0; i < frames.size(); i++) {
+    if (rc < 0) BufferPool::setUnlogged(frames[i]);
+    else if (lsns[i] >= 0) BufferPool::setRecLsn(frames[i], lsns[i]);
+    BufferPool::unpin(frames[i], false);
+  }
+
+  if (endLsn - checkpointLsn >= CHECKPOINT_LOG_SIZE) pthread_cond_signal(&logGrown);
+
+  // a recovery test stops the process once the commit is in the log
+  if (rc == 0 && crashAfter > 0 && --crashAfter == 0) ::kill(::getpid(), SIGKILL);
+
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
+
+bool WriteAheadLog::commitDue()
+{
+  return BufferPool::getUnloggedBytes() > BufferPool::getBudget() / 100 * COMMIT_PERCENT;
+}
+
+RC WriteAheadLog::checkpoint()
+{
+  RC rc;
+
+  pthread_mutex_lock(&lock);
+  rc = takeCheckpoint();
+  pthread_mutex_unlock(&lock);
+
+  return rc;
+}
+
+RC WriteAheadLog::takeCheckpoint()
+{
+  RC rc;
+  long long lsn;
+
+  if (logFd < 0) return 0;
+
+  // write back the committed pages and sync them. the pages committed
+  // before the checkpoint that are modified again cannot be written
+  // back, so the log is kept from their records on. the oldest record
+  // still needed is taken before the sync, since a page evicted in the
+  // meantime only reaches the disk with the sync
+  if ((rc = BufferPool::writeBackLogged()) < 0) return rc;
+  lsn = BufferPool::getMinRecLsn();
+  for (std::map<int, string>::iterator it = files.begin(); it != files.end(); ++it) {
+    if (::fdatasync(it->first) < 0) return RC_FILE_WRITE_FAILED;
+  }
+
+  redoLsn = (lsn < 0) ? endLsn : lsn;
+  checkpointLsn = endLsn;
+  return reclaim();
+}
+
+RC WriteAheadLog::reclaim()
+{
+  long long live = endLsn - redoLsn;
+  long long dead = redoLsn - baseLsn;
+  std::vector<char> buffer;
+
+  // only the new start of the recovery is recorded while the records
+  // still needed do not fit in the space before them
+  if (dead == 0 || dead < live) return writeHeader();
+
+  // move the records still needed to the front of the log. they are
+  // synced before the header refers to them, and the old copies stay
+  // intact until then since the two places do not overlap
+  buffer.resize(live < COPY_SIZE ? live : COPY_SIZE);
+  for (long long done = 0; done < live; ) {
+    ssize_t n = (live - done < COPY_SIZE) ? live - done : COPY_SIZE;
+    if (::pread(logFd, &buffer[0], n, offset(redoLsn) + done) != n) return RC_FILE_READ_FAILED;
+    if (::pwrite(logFd, &buffer[0], n, HEADER_SIZE + done) != n) return RC_FILE_WRITE_FAILED;
+    done += n;
+  }
+  if (live > 0 && ::fdatasync(logFd) < 0) return RC_FILE_WRITE_FAILED;
+
+  baseLsn = redoLsn;
+  if (writeHeader() < 0) return RC_FILE_WRITE_FAILED;
+  if (::ftruncate(logFd, HEADER_SIZE + live) < 0) return RC_FILE_WRITE_FAILED;
+
+  return 0;
+}
+
+void* WriteAheadLog::runCheckpointer(void* arg)
+{
+  struct timespec deadline;
+
+  pthread_mutex_lock(&lock);
+  for (;;) {
+    // wait until the log has grown enough or the interval is over
+    ::clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += CHECKPOINT_INTERVAL;
+    while (endLsn - checkpointLsn < CHECKPOINT_LOG_SIZE &&
+           pthread_cond_timedwait(&logGrown, &lock, &deadline) == 0);
+
+    // a failed checkpoint is tried again the next time
+    if (!files.empty() && endLsn > redoLsn) takeCheckpoint();
+    checkpointLsn = endLsn;
+  }
+
+  return NULL;
+}
+
+unsigned WriteAheadLog::checksum(const void* data, size_t length)
+{
+  // CRC-32
+  const unsigned char* p = (const unsigned char*) data;
+  const unsigned char* end = p + length;
+  unsigned c = 0xFFFFFFFF;
+
+  while (p < end) c = crcTable.entry[(c ^ *p++) & 0xFF] ^ (c >> 8);
+  return c ^ 0xFFFFFFFF;
+}
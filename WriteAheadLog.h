@@ -0,0 +1,145 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/types.h>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * The redo log shared by all files opened in 'w' mode.
+ * A page written to a logged file stays in the BufferPool until commit()
+ * appends the images of all pages modified since the last commit to the
+ * log, followed by a commit record, and syncs the log once. The pages
+ * may reach their files at any time after that, so random page writes
+ * turn into one sequential log append per commit, and the changes of
+ * several files (e.g., a table and its index) are committed together.
+ *
+ * A background thread takes a checkpoint whenever the log has grown by
+ * CHECKPOINT_LOG_SIZE bytes or CHECKPOINT_INTERVAL seconds have passed:
+ * it writes back the committed pages without blocking the readers of the
+ * pool, syncs the logged files and records in the log header the LSN
+ * from which a recovery has to replay the log. The dead part of the log
+ * before that LSN is reclaimed, so both the log and the restart time
+ * stay bounded.
+ *
+ * When the first file is opened after a crash, recover() writes the
+ * pages of every committed group after the checkpoint to their files and
+ * drops the rest. The log is emptied when the last logged file is
+ * closed, since all of its pages are then synced to their files.
+ */
+class WriteAheadLog {
+ public:
+
+  static const char* const LOG_NAME;  // the name of the log file
+
+  /**
+   * replay the committed pages in the log to their files if the last
+   * run of the program did not close all files. only the first call
+   * does the work; it is made by PageFile::open().
+   * @return error code. 0 if no error
+   */
+  static RC recover();
+
+  /**
+   * start logging the pages written to a file.
+   * @param fd[IN] the file descriptor of the file
+   * @param filename[IN] the name of the file
+   * @return error code. 0 if no error
+   */
+  static RC addFile(int fd, const std::string& filename);
+
+  /**
+   * stop logging a file after all of its pages are synced to the file.
+   * the log is emptied when no logged file is left open.
+   * @param fd[IN] the file descriptor of the file
+   * @return error code. 0 if no error
+   */
+  static RC removeFile(int fd);
+
+  /**
+   * log the images of all pages modified since the last commit and sync
+   * the log. the pages of all logged files are committed together.
+   * @return error code. 0 if no error
+   */
+  static RC commit();
+
+  /**
+   * @return true if the modified pages fill so much of the BufferPool
+   *         that they should be committed before more pages are written
+   */
+  static bool commitDue();
+
+  /**
+   * write back the committed pages and move the start of the recovery
+   * forward. this is done in the background as well.
+   * @return error code. 0 if no error
+   */
+  static RC checkpoint();
+
+  /**
+   * kill the process with SIGKILL right after a number of commits, as if
+   * it crashed there, so that recovery can be tested at a fixed point.
+   * @param commits[IN] # commits before the process is killed (0 never)
+   */
+  static void setCrashAfter(int commits) { crashAfter = commits; }
+
+ private:
+  static const int PAGE_RECORD = 1;    // the image of a page
+  static const int COMMIT_RECORD = 2;  // the end of a committed group
+
+  // the share of the pool the unlogged pages may fill before commitDue()
+  static const int COMMIT_PERCENT = 25;
+
+  // a checkpoint is taken after this many bytes of log or seconds
+  static const long long CHECKPOINT_LOG_SIZE = 64 * 1024 * 1024;
+  static const int CHECKPOINT_INTERVAL = 10;
+
+  // the records start after the header block of the log
+  static const int HEADER_SIZE = 512;
+
+  /**
+   * a log record is this header, followed by the file name and the page
+   * image for a PAGE_RECORD. the LSN of a record is its position in the
+   * log counted from the first record ever written, so a record left
+   * behind from an earlier use of the same file offset is recognized.
+   */
+  struct Record {
+    unsigned  checksum;     // checksum of the record after this field
+    int       type;         // PAGE_RECORD or COMMIT_RECORD
+    int       length;       // # bytes of the record with the header
+    int       nameLength;   // # bytes of the file name
+    long long lsn;          // the LSN of the record
+    PageId    pid;          // the page of a PAGE_RECORD
+  };
+
+  static int       logFd;       // file descriptor of the log (-1 if not open)
+  static long long baseLsn;     // the LSN at the file offset HEADER_SIZE
+  static long long endLsn;      // the LSN of the next record
+  static long long redoLsn;     // the LSN recovery starts from
+  static long long checkpointLsn;  // endLsn at the last checkpoint
+  static bool      recovered;   // true once recover() was called
+  static std::map<int, std::string> files;  // the logged files by descriptor
+
+  static pthread_mutex_t lock;      // serializes commits and checkpoints
+  static pthread_cond_t  logGrown;  // signaled when a checkpoint is due
+  static int       crashAfter;  // # commits left before the process is killed
+  static bool      checkpointerStarted;
+  static pthread_t checkpointer;
+
+  static off_t    offset(long long lsn) { return HEADER_SIZE + (lsn - baseLsn); }
+  static RC       openLog();
+  static RC       readHeader();
+  static RC       writeHeader();
+  static RC       readRecord(long long lsn, off_t size, std::vector<char>& record);
+  static RC       replay(off_t size);
+  static RC       takeCheckpoint();
+  static RC       reclaim();
+  static void*    runCheckpointer(void* arg);
+  static unsigned checksum(const void* data, size_t length);
+};
+
+#endif // WRITEAHEADLOG_H
@@ -0,0 +1,198 @@
+#include "Bruinbase.h"
+#include "ZoneMap.h"
+#include "PageHandle.h"
+#include <cstring>
+
+using std::string;
+
+// the header at the beginning of a page of the zone map
+struct ZonePageHeader {
+  int count;        // # zones in the page
+};
+
+// get the value prefix compared by the zones
+static void getPrefix(const char* value, int length, char* prefix)
+{
+  memset(prefix, 0, ZoneMap::PREFIX_LENGTH);
+  memcpy(prefix, value, (length < ZoneMap::PREFIX_LENGTH) ? length : ZoneMap::PREFIX_LENGTH);
+}
+
+// extend the bounds of a zone with a record
+static void extendZone(ZoneMap::Zone& zone, int key, const char* prefix)
+{
+  if (key < zone.minKey) zone.minKey = key;
+  if (key > zone.maxKey) zone.maxKey = key;
+  if (memcmp(prefix, zone.minValue, ZoneMap::PREFIX_LENGTH) < 0) memcpy(zone.minValue, prefix, ZoneMap::PREFIX_LENGTH);
+  if (memcmp(prefix, zone.maxValue, ZoneMap::PREFIX_LENGTH) > 0) memcpy(zone.maxValue, prefix, ZoneMap::PREFIX_LENGTH);
+}
+
+ZoneMap::ZoneMap()
+{
+  opened = false;
+  count = 0;
+  dirty = false;
+}
+
+RC ZoneMap::open(const string& filename, char mode, int pageSize)
+{
+  RC         rc;
+  PageHandle page;
+  PageId     epid;
+
+  if ((rc = pf.open(filename, mode, pageSize)) < 0) return rc;
+
+  // # zones is known from # zones in the last page
+  count = 0;
+  dirty = false;
+  if ((epid = pf.endPid()) > 0) {
+    if ((rc = pf.readPage(epid - 1, page)) < 0) {
+      pf.close();
+      return rc;
+    }
+    count = (epid - 1) * zonesPerPage() + ((const ZonePageHeader*) page.data())->count;
+    page.release();
+
+    // the last zone is extended by the records appended
+    if (count > 0 && (rc = read(count - 1, last)) < 0) {
+      pf.close();
+      return rc;
+    }
+  }
+
+  opened = true;
+  return 0;
+}
+
+RC ZoneMap::close()
+{
+  RC rc, closeRc;
+
+  if (!opened) return 0;
+
+  rc = flush();
+
+  // the pages left over from before clear() are cut off the file
+  for (PageId pid = (count + zonesPerPage() - 1) / zonesPerPage(); pid < pf.endPid(); pid++) {
+    if ((closeRc = pf.freePage(pid)) < 0 && rc == 0) rc = closeRc;
+  }
+  opened = false;
+  count = 0;
+  zoneOf.clear();
+
+  closeRc = pf.close();
+  return (rc < 0) ? rc : closeRc;
+}
+
+RC ZoneMap::read(int n, Zone& zone) const
+{
+  RC         rc;
+  PageHandle page;
+
+  if (n < 0 || n >= count) return RC_NO_SUCH_RECORD;
+
+  // the last zone may not be written yet
+  if (n == count - 1 && dirty) {
+    zone = last;
+    return 0;
+  }
+
+  if ((rc = pf.readPage(n / zonesPerPage(), page)) < 0) return rc;
+  memcpy(&zone, page.data() + sizeof(ZonePageHeader) + (n % zonesPerPage()) * sizeof(Zone), sizeof(Zone));
+
+  return 0;
+}
+
+RC ZoneMap::add(PageId pid, int key, const char* value, int length)
+{
+  RC   rc;
+  char prefix[PREFIX_LENGTH];
+
+  getPrefix(value, length, prefix);
+
+  // a record in a new page starts a new zone
+  if (count == 0 || last.pid != pid) {
+    if ((rc = flush()) < 0) return rc;
+    count++;
+    if (!zoneOf.empty()) zoneOf[pid] = count - 1;
+    last.pid = pid;
+    last.minKey = last.maxKey = key;
+    memcpy(last.minValue, prefix, PREFIX_LENGTH);
+    memcpy(last.maxValue, prefix, PREFIX_LENGTH);
+    dirty = true;
+    return 0;
+  }
+
+  extendZone(last, key, prefix);
+  dirty = true;
+
+  return 0;
+}
+
+RC ZoneMap::widen(PageId pid, int key, const char* value, int length)
+{
+  RC     rc;
+  char   page[PageFile::MAX_PAGE_SIZE];
+  char   prefix[PREFIX_LENGTH];
+  Zone   zone;
+  int    n;
+  std::map<PageId, int>::const_iterator it;
+
+  // the zone of the last page is still kept in memory
+  if (count > 0 && last.pid == pid) {
+    if ((rc = add(pid, key, value, length)) < 0) return rc;
+    return flush();
+  }
+
+  // the zones are looked up by their page once one is widened
+  if (zoneOf.empty()) {
+    for (n = 0; n < count; n++) {
+      if ((rc = read(n, zone)) < 0) return rc;
+      zoneOf[zone.pid] = n;
+    }
+  }
+  if ((it = zoneOf.find(pid)) == zoneOf.end()) return RC_NO_SUCH_RECORD;
+  n = it->second;
+
+  getPrefix(value, length, prefix);
+  if ((rc = pf.read(n / zonesPerPage(), page)) < 0) return rc;
+  memcpy(&zone, page + sizeof(ZonePageHeader) + (n % zonesPerPage()) * sizeof(Zone), sizeof(Zone));
+  extendZone(zone, key, prefix);
+  memcpy(page + sizeof(ZonePageHeader) + (n % zonesPerPage()) * sizeof(Zone), &zone, sizeof(Zone));
+  return pf.write(n / zonesPerPage(), page);
+}
+
+void ZoneMap::clear()
+{
+  count = 0;
+  dirty = false;
+  zoneOf.clear();
+}
+
+RC ZoneMap::flush()
+{
+  RC     rc;
+  char   page[PageFile::MAX_PAGE_SIZE];
+  PageId pid = (count - 1) / zonesPerPage();
+  int    n = (count - 1) % zonesPerPage();
+
+  if (!dirty) return 0;
+
+  // the first zone of a page starts a new page
+  if (n > 0) {
+    if ((rc = pf.read(pid, page)) < 0) return rc;
+  } else {
+    memset(page, 0, pf.getPageSize());
+  }
+
+  ((ZonePageHeader*) page)->count = n + 1;
+  memcpy(page + sizeof(ZonePageHeader) + n * sizeof(Zone), &last, sizeof(Zone));
+  if ((rc = pf.write(pid, page)) < 0) return rc;
+  dirty = false;
+
+  return 0;
+}
+
+int ZoneMap::zonesPerPage() const
+{
+  return (pf.getPageSize() - sizeof(ZonePageHeader)) / sizeof(Zone);
+}
@@ -0,0 +1,122 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include <map>
+#include <string>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * The zone map of a RecordFile: a side file that keeps, for every record
+ * page in the order of the file, the smallest and largest key and value
+ * prefix of the records in the page. A zone takes a few dozen bytes, so
+ * a scan reads the zones of many pages with one page of the zone map and
+ * skips the record pages whose zone cannot match its conditions.
+ *
+ * Only the zone of the last record page changes while records are
+ * appended; it is kept in memory and written by flush(). Deleted records
+ * leave the zones as they are, since they only get looser, until the
+ * zones are rebuilt after clear(). A record updated in place widens the
+ * zone of its page.
+ */
+class ZoneMap {
+ public:
+
+  static const int PREFIX_LENGTH = 8;  // # bytes of the value bounds
+
+  /**
+   * the bounds of the records in a record page. values are compared by
+   * their first PREFIX_LENGTH bytes, padded with '\0' if shorter
+   */
+  struct Zone {
+    PageId pid;                        // the record page
+    int    minKey;                     // the smallest key
+    int    maxKey;                     // the largest key
+    char   minValue[PREFIX_LENGTH];    // the smallest value prefix
+    char   maxValue[PREFIX_LENGTH];    // the largest value prefix
+  };
+
+  ZoneMap();
+
+  /**
+   * open the zone map file.
+   * when opened in 'w' mode, if the file does not exist, it is created.
+   * @param filename[IN] the name of the file to open
+   * @param mode[IN] the mode of PageFile::open()
+   * @param pageSize[IN] the page size of the file if it is created
+   * @return error code. 0 if no error
+   */
+  RC open(const std::string& filename, char mode, int pageSize);
+
+  /**
+   * write the zone of the last page and close the file.
+   * @return error code. 0 if no error
+   */
+  RC close();
+
+  /**
+   * @return true if the zone map is open
+   */
+  bool isOpen() const { return opened; }
+
+  /**
+   * @return # zones, i.e., # record pages of the RecordFile
+   */
+  int getCount() const { return count; }
+
+  /**
+   * read a zone.
+   * @param n[IN] the zone of the n'th record page (from 0)
+   * @param zone[OUT] the zone
+   * @return error code. 0 if no error
+   */
+  RC read(int n, Zone& zone) const;
+
+  /**
+   * extend the zone of a record page with a new record. a new zone is
+   * started if pid is not the page of the last zone.
+   * @param pid[IN] the record page the record was added to
+   * @param key[IN] the record key
+   * @param value[IN] the record value, or a prefix of it
+   * @param length[IN] # bytes of value
+   * @return error code. 0 if no error
+   */
+  RC add(PageId pid, int key, const char* value, int length);
+
+  /**
+   * extend the zone of any record page with a record updated in place,
+   * and write it to the file.
+   * @param pid[IN] the record page of the record
+   * @param key[IN] the record key
+   * @param value[IN] the new record value, or a prefix of it
+   * @param length[IN] # bytes of value
+   * @return error code. 0 if no error
+   */
+  RC widen(PageId pid, int key, const char* value, int length);
+
+  /**
+   * drop all zones, so that they are added again from the first record
+   * page. the pages of the file that are not written again are freed
+   * when the file is closed.
+   */
+  void clear();
+
+  /**
+   * write the zone of the last record page to the file.
+   * @return error code. 0 if no error
+   */
+  RC flush();
+
+ private:
+  PageFile pf;       // the PageFile used to store the zones
+  bool     opened;   // true if the file is open
+  int      count;    // # zones
+  Zone     last;     // the zone of the last record page
+  bool     dirty;    // true if last is not written yet
+  std::map<PageId, int> zoneOf;  // the zone of each record page,
+                                 // built by the first widen()
+
+  int zonesPerPage() const;
+};
+
+#endif // ZONEMAP_H
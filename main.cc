@@ -1,10 +1,48 @@
-
 #include "Bruinbase.h"
 #include "SqlEngine.h"
+#include "BufferPool.h"
+#include "WriteAheadLog.h"
 #include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
 
-int main()
+int main(int argc, char* argv[])
 {
+  int c;
+
+  // process the command line options
+  while ((c = getopt(argc, argv, "b:cdf:k:mp:")) != -1) {
+    switch (c) {
+    case 'b':  // size of the buffer pool in MB
+      if (BufferPool::init((size_t) atol(optarg) * 1024 * 1024) < 0) {
+        fprintf(stderr, "Error: cannot allocate a buffer pool of %s MB\n", optarg);
+        return 1;
+      }
+      break;
+    case 'c':  // LOAD creates tables with the columnar (PAX) page layout
+      SqlEngine::setTableLayout(RecordFile::PAX_LAYOUT);
+      break;
+    case 'd':  // SELECT reads files with direct I/O
+      SqlEngine::setReadMode('d');
+      break;
+    case 'f':  // percent of the index nodes filled by LOAD
+      SqlEngine::setIndexFill(atoi(optarg));
+      break;
+    case 'k':  // kill the process after this many commits, to test recovery
+      WriteAheadLog::setCrashAfter(atoi(optarg));
+      break;
+    case 'm':  // SELECT reads memory-mapped files
+      SqlEngine::setReadMode('m');
+      break;
+    case 'p':  // page size in bytes of the files created by LOAD
+      SqlEngine::setPageSize(atoi(optarg));
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-b pool_size_in_MB] [-c] [-d | -m] [-f fill_percent] [-k commits] [-p page_size]\n", argv[0]);
+      return 1;
+    }
+  }
+
   // run the SQL engine taking user commands from standard input (console).
   SqlEngine::run(stdin);
 
@@ -37,7 +37,7 @@ static void runSelect(int attr, const char* table, const std::vector<SelCond>& c
   std::vector<SelCond>* conds;
 }
 
-%token SELECT FROM WHERE LOAD WITH INDEX QUIT COUNT AND OR 
+%token SELECT FROM WHERE LOAD WITH INDEX QUIT COUNT AND OR DELETE UPDATE SET
 %token COMMA STAR LF
 %token <string> INTEGER STRING ID
 %token EQUAL NEQUAL LESS LESSEQUAL GREATER GREATEREQUAL 
@@ -56,6 +56,8 @@ commands:
 command:
         load_command { fprintf(stdout, "Bruinbase> "); }
 	| select_command { fprintf(stdout, "Bruinbase> "); }
+	| delete_command { fprintf(stdout, "Bruinbase> "); }
+	| update_command { fprintf(stdout, "Bruinbase> "); }
 	| quit_command
 	| error LF { fprintf(stdout, "Bruinbase> "); }
 	| LF { fprintf(stdout, "Bruinbase> "); }
@@ -94,6 +96,42 @@ select_command:
 	}
 	;
 
+delete_command:
+	DELETE FROM table LF {
+	        std::vector<SelCond> conds;
+		SqlEngine::remove($3, conds);
+		free($3);
+	}
+	| DELETE FROM table WHERE conditions LF {
+	        SqlEngine::remove($3, *$5);
+	  	free($3);
+	  	for (unsigned i = 0; i < $5->size(); i++) {
+		    free((*$5)[i].value);
+		}
+	  	delete $5;
+	}
+	;
+
+update_command:
+	UPDATE table SET attribute EQUAL value LF {
+	        std::vector<SelCond> conds;
+		if ($4 == 2) SqlEngine::update($2, $6, conds);
+		else sqlerror("only the value can be updated");
+		free($2);
+		free($6);
+	}
+	| UPDATE table SET attribute EQUAL value WHERE conditions LF {
+		if ($4 == 2) SqlEngine::update($2, $6, *$8);
+		else sqlerror("only the value can be updated");
+	  	free($2);
+	  	free($6);
+	  	for (unsigned i = 0; i < $8->size(); i++) {
+		    free((*$8)[i].value);
+		}
+	  	delete $8;
+	}
+	;
+
 conditions:
 	condition {
 	  std::vector<SelCond>* v = new std::vector<SelCond>;
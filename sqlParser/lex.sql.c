@@ -387,8 +387,8 @@ static void yy_fatal_error (yyconst char msg[]  );
 	*yy_cp = '\0'; \
 	(yy_c_buf_p) = yy_cp;
 
-#define YY_NUM_RULES 26
-#define YY_END_OF_BUFFER 27
+#define YY_NUM_RULES 29
+#define YY_END_OF_BUFFER 30
 /* This struct is not used in this scanner,
    but its presence is necessary. */
 struct yy_trans_info
@@ -396,21 +396,23 @@ struct yy_trans_info
 	flex_int32_t yy_verify;
 	flex_int32_t yy_nxt;
 	};
-static yyconst flex_int16_t yy_accept[113] =
+static yyconst flex_int16_t yy_accept[136] =
     {   0,
-        0,    0,   27,   26,   25,   23,   26,   26,   22,   21,
-       26,   18,   24,   15,   12,   14,   20,   20,   20,   20,
-       20,   20,   20,   20,   20,   20,   20,   20,   20,   20,
-       20,   20,   20,   20,   20,   20,   20,   25,   23,    0,
-       19,   18,   17,   13,   16,   20,   20,   20,   20,   20,
-       20,   20,   11,   20,   20,   20,   20,   20,   20,   20,
-       20,   20,   20,   20,   20,   20,   20,   10,   20,   20,
-       20,   20,   20,   20,   20,   20,   20,   20,   20,   20,
-       20,   20,   20,   20,   20,   20,   20,    8,    2,   20,
-        4,    7,   20,   20,    5,   20,   20,   20,   20,   20,
-
-        6,   20,    3,   20,   20,    0,    1,    0,    0,    0,
-        9,    0
+        0,    0,   30,   29,   28,   26,   29,   29,   25,   24,
+       29,   21,   27,   18,   15,   17,   23,   23,   23,   23,
+       23,   23,   23,   23,   23,   23,   23,   23,   23,   23,
+       23,   23,   23,   23,   23,   23,   23,   23,   23,   23,
+       23,   28,   26,    0,   22,   21,   20,   16,   19,   23,
+       23,   23,   23,   23,   23,   23,   23,   14,   23,   23,
+       23,   23,   23,   23,   23,   23,   23,   23,   23,   23,
+       23,   23,   23,   23,   23,   13,   23,   23,   23,   23,
+       23,   23,   23,   23,    7,   23,   23,   23,   23,   23,
+       23,   23,   23,   23,   23,   23,   23,   23,   23,   23,
+
+       23,   11,    2,   23,    4,   10,   23,   23,   23,    8,
+       23,   23,   23,   23,   23,   23,   23,   23,    9,   23,
+       23,    3,   23,   23,   23,   23,    0,    5,    1,    6,
+        0,    0,    0,   12,    0
     } ;
 
 static yyconst flex_int32_t yy_ec[256] =
@@ -422,12 +424,12 @@ static yyconst flex_int32_t yy_ec[256] =
         7,    8,    1,    9,   10,    1,    1,   11,   11,   11,
        11,   11,   11,   11,   11,   11,   11,    1,   12,   13,
        14,   15,    1,    1,   16,   17,   18,   19,   20,   21,
-       17,   22,   23,   17,   17,   24,   25,   26,   27,   17,
-       28,   29,   30,   31,   32,   17,   33,   34,   17,   17,
-        1,    1,    1,    1,   35,    1,   36,   17,   37,   38,
+       17,   22,   23,   17,   17,   24,   25,   26,   27,   28,
+       29,   30,   31,   32,   33,   17,   34,   35,   17,   17,
+        1,    1,    1,    1,   36,    1,   37,   17,   38,   39,
 
-       39,   40,   17,   41,   42,   17,   17,   43,   44,   45,
-       46,   17,   47,   48,   49,   50,   51,   17,   52,   53,
+       40,   41,   17,   42,   43,   17,   17,   44,   45,   46,
+       47,   48,   49,   50,   51,   52,   53,   17,   54,   55,
        17,   17,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -445,100 +447,110 @@ static yyconst flex_int32_t yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static yyconst flex_int32_t yy_meta[54] =
+static yyconst flex_int32_t yy_meta[56] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    2,
         2,    1,    1,    1,    1,    2,    2,    2,    2,    2,
         2,    2,    2,    2,    2,    2,    2,    2,    2,    2,
         2,    2,    2,    2,    2,    2,    2,    2,    2,    2,
         2,    2,    2,    2,    2,    2,    2,    2,    2,    2,
-        2,    2,    2
+        2,    2,    2,    2,    2
     } ;
 
-static yyconst flex_int16_t yy_base[115] =
+static yyconst flex_int16_t yy_base[138] =
     {   0,
-        0,    0,  144,  145,  141,  145,  139,  136,  145,  145,
-      129,  128,  145,   40,  145,  124,  111,    0,  109,  101,
-      105,  107,  105,  102,   98,  109,   34,   83,   81,   73,
-       77,   79,   77,   74,   70,   81,   17,  117,  145,  113,
-      145,  106,  145,  145,  145,    0,   97,   83,   91,   86,
-       93,   95,    0,   87,   85,   88,   76,   68,   54,   62,
-       57,   64,   65,   58,   56,   59,   47,    0,   70,   64,
-       69,   73,   73,   60,   70,   60,   66,   42,   36,   41,
-       45,   45,   32,   42,   32,   38,   47,    0,    0,   43,
-        0,    0,   58,   55,    0,   24,   20,   35,   32,   64,
-
-        0,   38,    0,   62,   17,   58,    0,   57,   57,   56,
-      145,  145,   59,   60
+        0,    0,  168,  169,  165,  169,  163,  160,  169,  169,
+      153,  152,  169,   42,  169,  148,  135,    0,  133,  139,
+      123,  127,  130,  128,  124,  120,  132,  123,   36,  104,
+      102,  108,   92,   96,   99,   97,   93,   89,  101,   92,
+       18,  137,  169,  133,  169,  126,  169,  169,  169,    0,
+      117,  102,  110,  110,  105,  112,  114,    0,  106,   38,
+      109,  107,   94,   86,   71,   79,   79,   74,   81,   82,
+       75,   19,   78,   76,   63,    0,   88,   93,   80,   86,
+       90,   90,   76,   87,    0,   90,   75,   82,   57,   62,
+       49,   55,   59,   59,   45,   56,   58,   44,   51,   60,
+
+       59,    0,    0,   55,    0,    0,   71,   56,   67,    0,
+       34,   33,   29,   45,   30,   41,   74,   59,    0,   46,
+       57,    0,   70,   35,   22,   29,   60,    0,    0,    0,
+       59,   59,   58,  169,  169,   71,   62
     } ;
 
-static yyconst flex_int16_t yy_def[115] =
+static yyconst flex_int16_t yy_def[138] =
     {   0,
-      112,    1,  112,  112,  112,  112,  112,  113,  112,  112,
-      112,  112,  112,  112,  112,  112,  114,  114,  114,  114,
-      114,  114,  114,  114,  114,  114,  114,  114,  114,  114,
-      114,  114,  114,  114,  114,  114,  114,  112,  112,  113,
-      112,  112,  112,  112,  112,  114,  114,  114,  114,  114,
-      114,  114,  114,  114,  114,  114,  114,  114,  114,  114,
-      114,  114,  114,  114,  114,  114,  114,  114,  114,  114,
-      114,  114,  114,  114,  114,  114,  114,  114,  114,  114,
-      114,  114,  114,  114,  114,  114,  114,  114,  114,  114,
-      114,  114,  114,  114,  114,  114,  114,  114,  114,  114,
-
-      114,  114,  114,  114,  114,  112,  114,  112,  112,  112,
-      112,    0,  112,  112
+      135,    1,  135,  135,  135,  135,  135,  136,  135,  135,
+      135,  135,  135,  135,  135,  135,  137,  137,  137,  137,
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+      137,  135,  135,  136,  135,  135,  135,  135,  135,  137,
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+      137,  137,  137,  137,  137,  137,  137,  137,  137,  137,
+      137,  137,  137,  137,  137,  137,  135,  137,  137,  137,
+      135,  135,  135,  135,    0,  135,  135
     } ;
 
-static yyconst flex_int16_t yy_nxt[199] =
+static yyconst flex_int16_t yy_nxt[225] =
     {   0,
         4,    5,    6,    7,    8,    4,    4,    9,   10,   11,
-       12,   13,   14,   15,   16,   17,   18,   19,   18,   20,
-       21,   18,   22,   23,   18,   18,   24,   25,   18,   26,
-       18,   18,   27,   18,    4,   28,   29,   18,   30,   31,
-       18,   32,   33,   18,   18,   34,   35,   18,   36,   18,
-       18,   37,   18,   43,   44,   56,   57,   66,   67,   40,
-       40,   46,  111,  111,  110,  109,  107,  108,  107,  106,
-      103,  105,  101,  104,  103,  102,  101,  100,   95,   99,
-       98,   92,   91,   97,   89,   88,   96,   95,   94,   93,
-       92,   91,   90,   89,   88,   87,   86,   85,   84,   83,
-
-       82,   81,   80,   79,   78,   68,   77,   76,   75,   74,
-       73,   72,   71,   70,   69,   68,   42,   41,   38,   65,
-       64,   53,   63,   62,   61,   60,   59,   58,   55,   54,
-       53,   52,   51,   50,   49,   48,   47,   45,   42,   42,
-       41,   39,   38,  112,    3,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112
-
+       12,   13,   14,   15,   16,   17,   18,   19,   20,   21,
+       22,   18,   23,   24,   18,   18,   25,   18,   26,   18,
+       27,   18,   28,   29,   18,    4,   30,   31,   32,   33,
+       34,   18,   35,   36,   18,   18,   37,   18,   38,   18,
+       39,   18,   40,   41,   18,   47,   48,   62,   63,   74,
+       75,   84,   96,   50,  134,  134,  133,  132,  130,   85,
+       85,   44,   44,  129,  128,  131,  130,  129,  128,  127,
+      122,  126,  125,  119,  124,  123,  122,  121,  120,  119,
+      118,  117,  110,  116,  115,  114,  106,  105,  113,  103,
+
+      102,  112,  111,  110,  109,  108,  107,  106,  105,  104,
+      103,  102,  101,  100,   99,   98,   97,   95,   94,   93,
+       92,   91,   90,   89,   76,   88,   87,   86,   83,   82,
+       81,   80,   79,   78,   77,   76,   46,   45,   42,   73,
+       72,   71,   58,   70,   69,   68,   67,   66,   65,   64,
+       61,   60,   59,   58,   57,   56,   55,   54,   53,   52,
+       51,   49,   46,   46,   45,   43,   42,  135,    3,  135,
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+      135,  135,  135,  135
     } ;
 
-static yyconst flex_int16_t yy_chk[199] =
+static yyconst flex_int16_t yy_chk[225] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,   14,   14,   27,   27,   37,   37,  113,
-      113,  114,  110,  109,  108,  106,  105,  104,  102,  100,
-       99,   98,   97,   96,   94,   93,   90,   87,   86,   85,
-       84,   83,   82,   81,   80,   79,   78,   77,   76,   75,
-       74,   73,   72,   71,   70,   69,   67,   66,   65,   64,
-
-       63,   62,   61,   60,   59,   58,   57,   56,   55,   54,
-       52,   51,   50,   49,   48,   47,   42,   40,   38,   36,
-       35,   34,   33,   32,   31,   30,   29,   28,   26,   25,
-       24,   23,   22,   21,   20,   19,   17,   16,   12,   11,
-        8,    7,    5,    3,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112,  112,  112,
-      112,  112,  112,  112,  112,  112,  112,  112
-
+        1,    1,    1,    1,    1,   14,   14,   29,   29,   41,
+       41,   60,   72,  137,  133,  132,  131,  127,  126,   60,
+       72,  136,  136,  125,  124,  123,  121,  120,  118,  117,
+      116,  115,  114,  113,  112,  111,  109,  108,  107,  104,
+      101,  100,   99,   98,   97,   96,   95,   94,   93,   92,
+
+       91,   90,   89,   88,   87,   86,   84,   83,   82,   81,
+       80,   79,   78,   77,   75,   74,   73,   71,   70,   69,
+       68,   67,   66,   65,   64,   63,   62,   61,   59,   57,
+       56,   55,   54,   53,   52,   51,   46,   44,   42,   40,
+       39,   38,   37,   36,   35,   34,   33,   32,   31,   30,
+       28,   27,   26,   25,   24,   23,   22,   21,   20,   19,
+       17,   16,   12,   11,    8,    7,    5,    3,  135,  135,
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+      135,  135,  135,  135,  135,  135,  135,  135,  135,  135,
+      135,  135,  135,  135
     } ;
 
 static yy_state_type yy_last_accepting_state;
@@ -570,7 +582,7 @@ char* strlower(char* s)
         }
 	return s;
 }
-#line 574 "lex.sql.c"
+#line 586 "lex.sql.c"
 
 #define INITIAL 0
 
@@ -760,7 +772,7 @@ YY_DECL
 #line 17 "SqlParser.l"
 
 
-#line 764 "lex.sql.c"
+#line 776 "lex.sql.c"
 
 	if ( !(yy_init) )
 		{
@@ -813,13 +825,13 @@ yy_match:
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
 				yy_current_state = (int) yy_def[yy_current_state];
-				if ( yy_current_state >= 113 )
+				if ( yy_current_state >= 136 )
 					yy_c = yy_meta[(unsigned int) yy_c];
 				}
 			yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
 			++yy_cp;
 			}
-		while ( yy_base[yy_current_state] != 145 );
+		while ( yy_base[yy_current_state] != 169 );
 
 yy_find_action:
 		yy_act = yy_accept[yy_current_state];
@@ -866,116 +878,131 @@ return LOAD;
 case 5:
 YY_RULE_SETUP
 #line 23 "SqlParser.l"
-return WITH;
+return DELETE;
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
 #line 24 "SqlParser.l"
-return INDEX;
+return UPDATE;
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
 #line 25 "SqlParser.l"
-return QUIT;
+return SET;
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
 #line 26 "SqlParser.l"
-return QUIT;
+return WITH;
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
 #line 27 "SqlParser.l"
-return COUNT;
+return INDEX;
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 29 "SqlParser.l"
-return AND;
+#line 28 "SqlParser.l"
+return QUIT;
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 30 "SqlParser.l"
-return OR;
+#line 29 "SqlParser.l"
+return QUIT;
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 31 "SqlParser.l"
-return EQUAL;
+#line 30 "SqlParser.l"
+return COUNT;
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
 #line 32 "SqlParser.l"
-return NEQUAL;
+return AND;
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
 #line 33 "SqlParser.l"
-return GREATER;
+return OR;
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
 #line 34 "SqlParser.l"
-return LESS;
+return EQUAL;
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
 #line 35 "SqlParser.l"
-return GREATEREQUAL;
+return NEQUAL;
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
 #line 36 "SqlParser.l"
-return LESSEQUAL;
+return GREATER;
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 38 "SqlParser.l"
-sqllval.string = strdup(sqltext); return INTEGER;
+#line 37 "SqlParser.l"
+return LESS;
 	YY_BREAK
 case 19:
-/* rule 19 can match eol */
 YY_RULE_SETUP
-#line 39 "SqlParser.l"
-sqllval.string = strdup(sqltext+1); sqllval.string[sqlleng-2] = 0; return STRING;
+#line 38 "SqlParser.l"
+return GREATEREQUAL;
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 40 "SqlParser.l"
-sqllval.string = strlower(strdup(sqltext)); return ID;
+#line 39 "SqlParser.l"
+return LESSEQUAL;
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
 #line 41 "SqlParser.l"
-return COMMA;
+sqllval.string = strdup(sqltext); return INTEGER;
 	YY_BREAK
 case 22:
+/* rule 22 can match eol */
 YY_RULE_SETUP
 #line 42 "SqlParser.l"
-return STAR;
+sqllval.string = strdup(sqltext+1); sqllval.string[sqlleng-2] = 0; return STRING;
 	YY_BREAK
 case 23:
-/* rule 23 can match eol */
 YY_RULE_SETUP
 #line 43 "SqlParser.l"
-return LF;
+sqllval.string = strlower(strdup(sqltext)); return ID;
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
 #line 44 "SqlParser.l"
-/* ignore semicolon */
+return COMMA;
 	YY_BREAK
 case 25:
 YY_RULE_SETUP
 #line 45 "SqlParser.l"
-/* ignore white space */
+return STAR;
 	YY_BREAK
 case 26:
+/* rule 26 can match eol */
+YY_RULE_SETUP
+#line 46 "SqlParser.l"
+return LF;
+	YY_BREAK
+case 27:
 YY_RULE_SETUP
 #line 47 "SqlParser.l"
+/* ignore semicolon */
+	YY_BREAK
+case 28:
+YY_RULE_SETUP
+#line 48 "SqlParser.l"
+/* ignore white space */
+	YY_BREAK
+case 29:
+YY_RULE_SETUP
+#line 50 "SqlParser.l"
 ECHO;
 	YY_BREAK
-#line 979 "lex.sql.c"
+#line 1006 "lex.sql.c"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -1267,7 +1294,7 @@ static int yy_get_next_buffer (void)
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
 			yy_current_state = (int) yy_def[yy_current_state];
-			if ( yy_current_state >= 113 )
+			if ( yy_current_state >= 136 )
 				yy_c = yy_meta[(unsigned int) yy_c];
 			}
 		yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
@@ -1295,11 +1322,11 @@ static int yy_get_next_buffer (void)
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
 		yy_current_state = (int) yy_def[yy_current_state];
-		if ( yy_current_state >= 113 )
+		if ( yy_current_state >= 136 )
 			yy_c = yy_meta[(unsigned int) yy_c];
 		}
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
-	yy_is_jam = (yy_current_state == 112);
+	yy_is_jam = (yy_current_state == 135);
 
 	return yy_is_jam ? 0 : yy_current_state;
 }
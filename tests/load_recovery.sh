@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# Interrupt LOAD ... WITH INDEX right after fixed commits and check that,
+# after the WriteAheadLog is recovered, the index holds the keys of the
+# table. bruinbase -k kills the process with SIGKILL after a number of
+# commits, so each round stops at the same point of its load:
+#
+#   round 1: while the rows of a new index are loaded
+#   round 2: while the index of round 1 is merged with the new keys
+#   round 3: while the rows are loaded again
+#   round 4: not at all. the load builds the index left by round 3 again
+#
+# An interrupted load leaves the index stale, and SELECT scans the table
+# until the next change of the table builds the index again. A DELETE that
+# matches no tuple does that after rounds 1 and 2.
+#
+# usage: tests/load_recovery.sh [path to bruinbase]
+
+BRUINBASE=$(cd "$(dirname "${1:-./bruinbase}")" && pwd)/$(basename "${1:-./bruinbase}")
+ROWS=300000
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+# list the sorted keys found by a table scan and by an index search
+keys() {
+  echo "$1" | "$BRUINBASE" 2>/dev/null | sed -n 's/^\(Bruinbase> \)*\([0-9][0-9]*\)$/\2/p' | sort
+}
+
+status=0
+round=1
+for crash in 10 30 10 0; do
+  # each round loads distinct keys in an order other than the key order
+  awk -v r=$round -v n=$ROWS 'BEGIN {
+    for (i = 0; i < n; i++) printf "%d,\047v%d\047\n", r * 1000003 + (i * 7919) % 1000003, i
+  }' > rows.del
+
+  # a small pool commits the load in many groups
+  echo "load t from 'rows.del' with index" | "$BRUINBASE" -b 1 -k $crash >/dev/null 2>&1
+  if [ $round -le 2 ]; then
+    echo "delete from t where key < 0" | "$BRUINBASE" >/dev/null 2>&1
+  fi
+
+  keys "select key from t where value > 'a'" > table.keys
+  keys "select key from t where key >= 0" > index.keys
+  rows=$(wc -l < table.keys)
+  if [ "$rows" -eq 0 ] || ! cmp -s table.keys index.keys; then
+    echo "round $round: the index does not hold the $rows keys of the table"
+    status=1
+  else
+    echo "round $round: $rows rows"
+  fi
+  round=$((round + 1))
+done
+
+exit $status